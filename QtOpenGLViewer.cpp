@@ -4,16 +4,44 @@
 
 #include "QtOpenGLViewer.h"
 
+#include <algorithm>
 #include <climits>
 #include <cmath>
+#include <cstring>
+#include <stdexcept>
 
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QImageReader>
 #include <QKeyEvent>
 #include <QMatrix4x4>
 #include <QMessageBox>
 #include <QMouseEvent>
+#include <QOffscreenSurface>
+#include <QOpenGLExtraFunctions>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QScopedPointer>
+#include <QStandardPaths>
+#include <QStringList>
+#include <QTextStream>
 #include <QVector4D>
 #include <QWheelEvent>
 
+// program binary enums (missing from some GL headers)
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
 QVector3D QtOpenGLViewer::screen2World(QVector3D screen, int *viewport, float *projection, float *modelview)
 {
     QMatrix4x4 P(projection);
@@ -244,12 +272,101 @@ QVector3D QtOpenGLViewer::pickPointInPlane(const QPoint &mousePosition, const QV
     return pointOnPlane;
 }
 
+void QtOpenGLViewer::getOrthoBox(float &left, float &right, float &bottom, float &top, float &near, float &far) const
+{
+    // ortho box is sized relative to zoom distance
+    float zoom = camera.view().length();
+    left = -zoom / 2;
+    right = zoom / 2;
+    bottom = -zoom / 2;
+    top = zoom / 2;
+    near = zoom / 100;
+    far = zoom * 2;
+    float aspect = float(width()) / height();
+    if(aspect < 1) {
+        bottom /= aspect;
+        top /= aspect;
+    } else if(aspect > 1) {
+        left *= aspect;
+        right *= aspect;
+    }
+}
+
+QRectF QtOpenGLViewer::visibleRect() const
+{
+    float left, right, bottom, top, near, far;
+    getOrthoBox(left, right, bottom, top, near, far);
+    return QRectF(camera.eye.x() + left, camera.eye.y() + bottom, right - left, top - bottom);
+}
+
+void QtOpenGLViewer::setLatencyHistogram(QtOpenGLLatencyHistogram *histogram)
+{
+    _latencyHistogram = histogram;
+    _pendingInputTimes.clear();
+    if(histogram && !_latencyClock.isValid()) _latencyClock.start();
+}
+
+void QtOpenGLViewer::requestFrame()
+{
+    _frameRequests++;
+    repaint();
+}
+
+void QtOpenGLViewer::linkCamera(QtOpenGLViewer *viewer)
+{
+    if(!viewer || viewer == this) return;
+    if(!_cameraLinks) {
+        _cameraLinks = QSharedPointer<QList<QtOpenGLViewer*> >(new QList<QtOpenGLViewer*>);
+        _cameraLinks->append(this);
+    }
+    if(viewer->_cameraLinks == _cameraLinks) return;
+    // merge the other viewer's group into ours
+    QList<QtOpenGLViewer*> others;
+    if(viewer->_cameraLinks) others = *viewer->_cameraLinks;
+    else others.append(viewer);
+    for(QtOpenGLViewer *other : others) {
+        other->_cameraLinks = _cameraLinks;
+        other->camera = camera;
+        _cameraLinks->append(other);
+        other->update();
+    }
+}
+
+void QtOpenGLViewer::unlinkCamera()
+{
+    if(!_cameraLinks) return;
+    _cameraLinks->removeAll(this);
+    _cameraLinks.clear();
+}
+
+QList<QtOpenGLViewer*> QtOpenGLViewer::linkedViewers() const
+{
+    QList<QtOpenGLViewer*> viewers;
+    if(_cameraLinks) {
+        for(QtOpenGLViewer *viewer : *_cameraLinks) {
+            if(viewer != this) viewers.append(viewer);
+        }
+    }
+    return viewers;
+}
+
+void QtOpenGLViewer::syncLinkedCameras()
+{
+    emit cameraChanged();
+    for(QtOpenGLViewer *viewer : linkedViewers()) {
+        viewer->camera = camera;
+        viewer->update();
+        emit viewer->cameraChanged();
+    }
+}
+
 void QtOpenGLViewer::goToDefaultView()
 {
     camera.eye = QVector3D(0, 0, 10);
     camera.center = QVector3D(0, 0, 0);
     camera.up = QVector3D(0, 1, 0);
-    repaint();
+    syncLinkedCameras();
+    requestFrame();
 }
 
 void QtOpenGLViewer::deleteSelectedObject()
@@ -261,7 +378,7 @@ void QtOpenGLViewer::deleteSelectedObject()
     delete _selectedObject;
     _selectedObject = NULL;
     emit selectedObjectChanged(_selectedObject);
-    repaint();
+    requestFrame();
 }
 
 void QtOpenGLViewer::editSelectedObject(const QPoint &mousePosition)
@@ -278,6 +395,8 @@ void QtOpenGLViewer::editSelectedObject(const QPoint &mousePosition)
 
 void QtOpenGLViewer::initializeGL()
 {
+    _startupTimer.start();
+    _startupNsecs = -1;
     initializeOpenGLFunctions();
     glClearColor(_backgroundColor.redF(), _backgroundColor.greenF(), _backgroundColor.blueF(), _backgroundColor.alphaF());
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
@@ -319,22 +438,8 @@ void QtOpenGLViewer::paintGL()
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     // ortho projection (call here to handle zoom)
-    // ortho box is sized relative to zoom distance
-    float zoom = camera.view().length();
-    float left = -zoom / 2;
-    float right = zoom / 2;
-    float bottom = -zoom / 2;
-    float top = zoom / 2;
-    float near = zoom / 100;
-    float far = zoom * 2;
-    float aspect = float(width()) / height();
-    if(aspect < 1) {
-        bottom /= aspect;
-        top /= aspect;
-    } else if(aspect > 1) {
-        left *= aspect;
-        right *= aspect;
-    }
+    float left, right, bottom, top, near, far;
+    getOrthoBox(left, right, bottom, top, near, far);
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
     glOrtho(left, right, bottom, top, near, far);
@@ -387,6 +492,42 @@ void QtOpenGLViewer::paintGL()
     glPopAttrib();
     glPopAttrib();
     glPopAttrib();
+    
+    if(_startupNsecs < 0) {
+        _startupNsecs = _startupTimer.nsecsElapsed();
+#ifdef DEBUG
+        QtOpenGLProgramCache &cache = QtOpenGLProgramCache::instance();
+        qDebug() << "QtOpenGLViewer startup:" << _startupNsecs / 1e6 << "ms,"
+                 << cache.coldBuilds() << "cold programs in" << cache.coldNsecs() / 1e6 << "ms,"
+                 << cache.warmBuilds() << "warm programs in" << cache.warmNsecs() / 1e6 << "ms";
+#endif
+    }
+    
+    // input-to-frame latency
+    if(_latencyHistogram && !_pendingInputTimes.isEmpty()) {
+        glFinish(); // frame is done on the GPU
+        qint64 nsecs = _latencyClock.nsecsElapsed();
+        for(qint64 inputNsecs : _pendingInputTimes) {
+            _latencyHistogram->add(nsecs - inputNsecs);
+        }
+        _pendingInputTimes.clear();
+    }
+}
+
+bool QtOpenGLViewer::event(QEvent *event)
+{
+    if(!QtOpenGLInputRecorder::isRecordable(event->type()) || (!_inputRecorder && !_latencyHistogram))
+        return QOpenGLWidget::event(event);
+    if(_inputRecorder) _inputRecorder->record(event);
+    if(!_latencyHistogram) return QOpenGLWidget::event(event);
+    // tag the input, the frame reflecting it is timed at the end of paintGL()
+    qint64 nsecs = _latencyClock.nsecsElapsed();
+    _pendingInputTimes.append(nsecs);
+    quint64 frameRequests = _frameRequests;
+    bool result = QOpenGLWidget::event(event);
+    // input that is ignored or doesn't ask for a frame would otherwise be charged to some later, unrelated frame
+    if(!event->isAccepted() || _frameRequests == frameRequests) _pendingInputTimes.removeOne(nsecs);
+    return result;
 }
 
 void QtOpenGLViewer::keyPressEvent(QKeyEvent *event)
@@ -418,7 +559,7 @@ void QtOpenGLViewer::mousePressEvent(QMouseEvent *event)
             _mousePosition = event->pos();
             setMouseTracking(true);
         }
-        repaint();
+        requestFrame();
         return;
     } else if(event->button() == Qt::MiddleButton || (!is3D() && (event->button() == Qt::RightButton))) {
         // pan
@@ -481,7 +622,8 @@ void QtOpenGLViewer::mouseMoveEvent(QMouseEvent *event)
                 float ez = camera.eye.x() * rotation[6] + camera.eye.y() * rotation[7] + camera.eye.z() * rotation[8];
                 camera.eye = QVector3D(ex, ey, ez);
                 camera.eye += camera.center; // shift back to center.
-                repaint();
+                syncLinkedCameras();
+                requestFrame();
                 return;
             }
         } else if(pan) {
@@ -489,7 +631,8 @@ void QtOpenGLViewer::mouseMoveEvent(QMouseEvent *event)
             QVector3D translation = xhat * (dx / width() * zoom) + yhat * (dy / height() * zoom);
             camera.center -= translation;
             camera.eye -= translation;
-            repaint();
+            syncLinkedCameras();
+            requestFrame();
             return;
         }
     } // rotate || pan
@@ -514,7 +657,8 @@ void QtOpenGLViewer::wheelEvent(QWheelEvent *event)
         zoom = 1e-5;
     }
     camera.zoom(zoom);
-    repaint();
+    syncLinkedCameras();
+    requestFrame();
 }
 
 void QtOpenGLViewer::mouseDoubleClickEvent(QMouseEvent *event)
@@ -528,3 +672,1401 @@ void QtOpenGLViewer::mouseDoubleClickEvent(QMouseEvent *event)
     }
     QOpenGLWidget::mouseDoubleClickEvent(event);
 }
+
+QtOpenGLProgramCache::QtOpenGLProgramCache()
+{
+    _cacheDirectory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/QtOpenGLViewer/programs";
+}
+
+QtOpenGLProgramCache &QtOpenGLProgramCache::instance()
+{
+    static QtOpenGLProgramCache cache;
+    return cache;
+}
+
+void QtOpenGLProgramCache::clear()
+{
+    QDir dir(_cacheDirectory);
+    for(const QString &fileName : dir.entryList(QStringList() << "*.bin", QDir::Files)) {
+        dir.remove(fileName);
+    }
+}
+
+bool QtOpenGLProgramCache::build(QOpenGLShaderProgram *program, const QString &vertexShader, const QString &fragmentShader)
+{
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    if(!context)
+        throw std::runtime_error("QtOpenGLProgramCache::build: No current OpenGL context.");
+    QElapsedTimer timer;
+    timer.start();
+    if(!program->create()) return false;
+    bool useBinary = _isEnabled && isSupported(context);
+    QString path = useBinary ? cachePath(context, vertexShader, fragmentShader) : QString();
+    
+    // warm: load cached binary
+    if(useBinary && QFile::exists(path)) {
+        QFile file(path);
+        if(file.open(QIODevice::ReadOnly)) {
+            QDataStream in(&file);
+            quint32 binaryFormat = 0;
+            QByteArray binary;
+            in >> binaryFormat >> binary;
+            file.close();
+            if(in.status() == QDataStream::Ok && !binary.isEmpty()) {
+                context->extraFunctions()->glProgramBinary(program->programId(), binaryFormat, binary.constData(), binary.size());
+                if(program->link()) { // no shaders attached, so this just checks the link status
+                    _warmBuilds++;
+                    _warmNsecs += timer.nsecsElapsed();
+                    return true;
+                }
+                // driver rejected the binary, so rebuild it from source
+                _rejectedBinaries++;
+            }
+        }
+        QFile::remove(path);
+    }
+    
+    // cold: compile and link from source
+    if(!program->addShaderFromSourceCode(QOpenGLShader::Vertex, vertexShader)) return false;
+    if(!program->addShaderFromSourceCode(QOpenGLShader::Fragment, fragmentShader)) return false;
+    if(useBinary) context->extraFunctions()->glProgramParameteri(program->programId(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    if(!program->link()) return false;
+    if(useBinary) {
+        GLint length = 0;
+        context->functions()->glGetProgramiv(program->programId(), GL_PROGRAM_BINARY_LENGTH, &length);
+        if(length > 0) {
+            QByteArray binary(length, Qt::Uninitialized);
+            GLsizei written = 0;
+            GLenum binaryFormat = 0;
+            context->extraFunctions()->glGetProgramBinary(program->programId(), length, &written, &binaryFormat, binary.data());
+            binary.resize(written);
+            QDir().mkpath(_cacheDirectory);
+            // write to a temporary file and rename so concurrent viewer processes never see a partial binary
+            QSaveFile file(path);
+            if(written > 0 && file.open(QIODevice::WriteOnly)) {
+                QDataStream out(&file);
+                out << quint32(binaryFormat) << binary;
+                file.commit();
+            }
+        }
+    }
+    _coldBuilds++;
+    _coldNsecs += timer.nsecsElapsed();
+    return true;
+}
+
+bool QtOpenGLProgramCache::isSupported(QOpenGLContext *context)
+{
+    QPair<int, int> version = context->format().version();
+    bool core = context->isOpenGLES() ? version >= qMakePair(3, 0) : version >= qMakePair(4, 1);
+    if(!core && !context->hasExtension("GL_ARB_get_program_binary") && !context->hasExtension("GL_OES_get_program_binary"))
+        return false;
+    GLint numFormats = 0;
+    context->functions()->glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+    return numFormats > 0;
+}
+
+QString QtOpenGLProgramCache::cachePath(QOpenGLContext *context, const QString &vertexShader, const QString &fragmentShader)
+{
+    QOpenGLFunctions *f = context->functions();
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(vertexShader.toUtf8());
+    hash.addData("\0", 1);
+    hash.addData(fragmentShader.toUtf8());
+    hash.addData("\0", 1);
+    hash.addData(reinterpret_cast<const char*>(f->glGetString(GL_VENDOR)));
+    hash.addData(reinterpret_cast<const char*>(f->glGetString(GL_RENDERER)));
+    hash.addData(reinterpret_cast<const char*>(f->glGetString(GL_VERSION)));
+    return _cacheDirectory + "/" + QString::fromLatin1(hash.result().toHex()) + ".bin";
+}
+
+QtOpenGLResourcePool &QtOpenGLResourcePool::instance()
+{
+    static QtOpenGLResourcePool pool;
+    return pool;
+}
+
+QByteArray QtOpenGLResourcePool::contentKey(const void *data, int bytes)
+{
+    return QCryptographicHash::hash(QByteArray::fromRawData(static_cast<const char*>(data), bytes), QCryptographicHash::Sha1);
+}
+
+void QtOpenGLResourcePool::setMemoryBudget(qint64 bytes)
+{
+    _memoryBudget = bytes > 0 ? bytes : 0;
+    if(QOpenGLContext::currentContext()) evict();
+}
+
+QOpenGLBuffer *QtOpenGLResourcePool::acquireBuffer(const QByteArray &key, const void *data, int bytes, QOpenGLBuffer::Type type)
+{
+    if(Resource *resource = find(key)) {
+        if(!resource->buffer) throw std::runtime_error("QtOpenGLResourcePool::acquireBuffer: Key is not a buffer.");
+        retain(resource);
+        return resource->buffer;
+    }
+    Resource resource;
+    resource.buffer = new QOpenGLBuffer(type);
+    resource.buffer->create();
+    resource.buffer->bind();
+    resource.buffer->allocate(data, bytes);
+    resource.buffer->release();
+    resource.bytes = bytes;
+    return insert(key, resource)->buffer;
+}
+
+QOpenGLTexture *QtOpenGLResourcePool::acquireTexture(const QByteArray &key, const QImage &image)
+{
+    if(Resource *resource = find(key)) {
+        if(!resource->texture) throw std::runtime_error("QtOpenGLResourcePool::acquireTexture: Key is not a texture.");
+        retain(resource);
+        return resource->texture;
+    }
+    Resource resource;
+    resource.texture = new QOpenGLTexture(image);
+    resource.bytes = qint64(image.width()) * image.height() * 4 * 4 / 3; // RGBA with mipmaps
+    return insert(key, resource)->texture;
+}
+
+QOpenGLShaderProgram *QtOpenGLResourcePool::acquireProgram(const QByteArray &key, const QString &vertexShader, const QString &fragmentShader)
+{
+    if(Resource *resource = find(key)) {
+        if(!resource->program) throw std::runtime_error("QtOpenGLResourcePool::acquireProgram: Key is not a program.");
+        retain(resource);
+        return resource->program;
+    }
+    Resource resource;
+    resource.program = new QOpenGLShaderProgram;
+    if(!QtOpenGLProgramCache::instance().build(resource.program, vertexShader, fragmentShader)) {
+        QString log = resource.program->log();
+        delete resource.program;
+        throw std::runtime_error("QtOpenGLResourcePool::acquireProgram: " + log.toStdString());
+    }
+    return insert(key, resource)->program;
+}
+
+void QtOpenGLResourcePool::release(const QByteArray &key)
+{
+    QHash<ResourceKey, Resource>::iterator it = _resources.find(ResourceKey(currentGroup(), key));
+    if(it == _resources.end() || it->refCount == 0) return;
+    it->refCount--;
+    it->lastUsed = ++_clock;
+    if(it->refCount == 0 && _memoryUsage > _memoryBudget) evict();
+}
+
+QOpenGLContextGroup *QtOpenGLResourcePool::currentGroup()
+{
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    if(!context)
+        throw std::runtime_error("QtOpenGLResourcePool: No current OpenGL context.");
+    watch(context);
+    return context->shareGroup();
+}
+
+void QtOpenGLResourcePool::watch(QOpenGLContext *context)
+{
+    // free the group's resources before its last context goes away
+    if(_contexts.contains(context)) return;
+    _contexts.insert(context);
+    connect(context, &QOpenGLContext::aboutToBeDestroyed, this, [this, context]() { contextAboutToBeDestroyed(context); });
+}
+
+QtOpenGLResourcePool::Resource *QtOpenGLResourcePool::find(const QByteArray &key)
+{
+    QHash<ResourceKey, Resource>::iterator it = _resources.find(ResourceKey(currentGroup(), key));
+    return it == _resources.end() ? NULL : &it.value();
+}
+
+void QtOpenGLResourcePool::retain(Resource *resource)
+{
+    resource->refCount++;
+    resource->lastUsed = ++_clock;
+}
+
+QtOpenGLResourcePool::Resource *QtOpenGLResourcePool::insert(const QByteArray &key, const Resource &resource)
+{
+    ResourceKey resourceKey(currentGroup(), key);
+    _memoryUsage += resource.bytes;
+    QHash<ResourceKey, Resource>::iterator it = _resources.insert(resourceKey, resource);
+    it->refCount = 1;
+    it->lastUsed = ++_clock;
+    evict();
+    return &_resources[resourceKey]; // evict() may rehash
+}
+
+void QtOpenGLResourcePool::destroy(const ResourceKey &key)
+{
+    QHash<ResourceKey, Resource>::iterator it = _resources.find(key);
+    if(it == _resources.end()) return;
+    delete it->buffer;
+    delete it->texture;
+    delete it->program;
+    _memoryUsage -= it->bytes;
+    _resources.erase(it);
+}
+
+void QtOpenGLResourcePool::evict()
+{
+    // Only resources in the current share group can be deleted here.
+    // Others are evicted the next time a context in their group is current.
+    QOpenGLContextGroup *group = currentGroup();
+    while(_memoryUsage > _memoryBudget) {
+        QHash<ResourceKey, Resource>::const_iterator lru = _resources.constEnd();
+        for(QHash<ResourceKey, Resource>::const_iterator it = _resources.constBegin(); it != _resources.constEnd(); ++it) {
+            if(it.key().first == group && it->refCount == 0 && (lru == _resources.constEnd() || it->lastUsed < lru->lastUsed))
+                lru = it;
+        }
+        if(lru == _resources.constEnd()) break; // everything left is in use
+        destroy(lru.key());
+    }
+}
+
+void QtOpenGLResourcePool::contextAboutToBeDestroyed(QOpenGLContext *context)
+{
+    _contexts.remove(context);
+    QOpenGLContextGroup *group = context->shareGroup();
+    for(QOpenGLContext *share : group->shares()) {
+        if(share != context) {
+            // the resources live on with the other contexts, watch one of them instead
+            watch(share);
+            return;
+        }
+    }
+    QList<ResourceKey> keys;
+    QList<QByteArray> lostKeys;
+    for(QHash<ResourceKey, Resource>::const_iterator it = _resources.constBegin(); it != _resources.constEnd(); ++it) {
+        if(it.key().first != group) continue;
+        keys.append(it.key());
+        if(it->refCount > 0) lostKeys.append(it.key().second);
+    }
+    if(keys.isEmpty()) return;
+    QOffscreenSurface surface;
+    QOpenGLContext *previous = QOpenGLContext::currentContext();
+    QSurface *previousSurface = previous ? previous->surface() : NULL;
+    if(previous != context) {
+        surface.setFormat(context->format());
+        surface.create();
+        context->makeCurrent(&surface);
+    }
+    for(const ResourceKey &key : keys) {
+        destroy(key);
+    }
+    if(previous != context) {
+        // restore whatever was current, the surface must not be current when it goes away
+        context->doneCurrent();
+        if(previous) previous->makeCurrent(previousSurface);
+    }
+    if(!lostKeys.isEmpty()) emit resourcesLost(group, lostKeys);
+}
+
+QVector<QtOpenGLTilePyramid::Level> QtOpenGLTilePyramid::layout(qint64 width, qint64 height, int tileSize)
+{
+    QVector<Level> levels;
+    if(width <= 0 || height <= 0 || width > MaxImageSize || height > MaxImageSize || tileSize <= 0 || tileSize > MaxTileSize) return levels;
+    qint64 tilesX = (width + tileSize - 1) / tileSize;
+    qint64 tilesY = (height + tileSize - 1) / tileSize;
+    if(tilesX > MaxTiles || tilesY > MaxTiles) return levels;
+    qint64 offset = HeaderSize;
+    qint64 tileBytes = qint64(tileSize) * tileSize * 4;
+    while(true) {
+        Level level;
+        level.width = width;
+        level.height = height;
+        level.tilesX = qint32((width + tileSize - 1) / tileSize);
+        level.tilesY = qint32((height + tileSize - 1) / tileSize);
+        level.offset = offset;
+        qint64 tiles = qint64(level.tilesX) * level.tilesY;
+        if(tiles > (LLONG_MAX - offset) / tileBytes) return QVector<Level>();
+        offset += tileBytes * tiles;
+        levels.append(level);
+        if(level.tilesX <= 1 && level.tilesY <= 1) break;
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+    }
+    return levels;
+}
+
+bool QtOpenGLTilePyramid::open(const QString &path)
+{
+    close();
+    _file.setFileName(path);
+    if(!_file.open(QIODevice::ReadOnly)) return false;
+    QDataStream in(&_file);
+    quint32 magic = 0, version = 0;
+    qint32 tileSize = 0, levelCount = 0;
+    in >> magic >> version >> tileSize >> levelCount;
+    if(in.status() != QDataStream::Ok || magic != Magic || version != Version
+       || tileSize <= 0 || tileSize > MaxTileSize || levelCount <= 0 || levelCount > MaxLevels) {
+        _file.close();
+        return false;
+    }
+    QVector<Level> levels(levelCount);
+    for(Level &level : levels) {
+        in >> level.width >> level.height >> level.tilesX >> level.tilesY >> level.offset;
+    }
+    if(in.status() != QDataStream::Ok) {
+        close();
+        return false;
+    }
+    // the header must be exactly what build() writes for this size, so every tile lies inside the file
+    QVector<Level> expected = layout(levels[0].width, levels[0].height, tileSize);
+    if(expected.isEmpty() || expected.size() != levels.size()) {
+        close();
+        return false;
+    }
+    for(int i = 0; i < levels.size(); ++i) {
+        const Level &a = levels[i];
+        const Level &b = expected[i];
+        if(a.width != b.width || a.height != b.height || a.tilesX != b.tilesX || a.tilesY != b.tilesY || a.offset != b.offset) {
+            close();
+            return false;
+        }
+    }
+    const Level &last = levels.last();
+    qint64 size = last.offset + qint64(tileSize) * tileSize * 4 * last.tilesX * last.tilesY;
+    if(_file.size() < size) {
+        close();
+        return false;
+    }
+    _data = _file.map(0, size);
+    if(!_data) {
+        close();
+        return false;
+    }
+    _tileSize = tileSize;
+    _levels = levels;
+    return true;
+}
+
+void QtOpenGLTilePyramid::close()
+{
+    if(_data) _file.unmap(_data);
+    _data = NULL;
+    _file.close();
+    _tileSize = 0;
+    _levels.clear();
+}
+
+const uchar *QtOpenGLTilePyramid::tile(int level, int tx, int ty) const
+{
+    if(!_data || level < 0 || level >= _levels.size()) return NULL;
+    const Level &lvl = _levels[level];
+    if(tx < 0 || tx >= lvl.tilesX || ty < 0 || ty >= lvl.tilesY) return NULL;
+    return _data + lvl.offset + (qint64(ty) * lvl.tilesX + tx) * _tileSize * _tileSize * 4;
+}
+
+bool QtOpenGLTilePyramid::buildFromRaw(const QString &rawPath, qint64 width, qint64 height, int channels, const QString &pyramidPath, int tileSize)
+{
+    // rows are read as QImage bands, so a row has to fit in an int
+    if((channels != 1 && channels != 3 && channels != 4) || width <= 0 || height <= 0 || width > INT_MAX / 4
+       || height > LLONG_MAX / (width * channels) || layout(width, height, tileSize).isEmpty()) return false;
+    QFile raw(rawPath);
+    if(!raw.open(QIODevice::ReadOnly) || raw.size() < width * height * channels) return false;
+    uchar *pixels = raw.map(0, width * height * channels);
+    if(!pixels) return false;
+    QImage::Format format = channels == 1 ? QImage::Format_Grayscale8 : (channels == 3 ? QImage::Format_RGB888 : QImage::Format_RGBA8888);
+    bool ok = build(pyramidPath, width, height, tileSize, [&](qint64 y, int rows) {
+        const uchar *band = pixels + y * width * channels;
+        return QImage(band, int(width), rows, int(width * channels), format).convertToFormat(QImage::Format_RGBA8888);
+    });
+    raw.unmap(pixels);
+    return ok;
+}
+
+bool QtOpenGLTilePyramid::buildFromImage(const QString &imagePath, const QString &pyramidPath, int tileSize)
+{
+    // decoded once as a whole, so the image has to fit in a QImage
+    QImage image = QImageReader(imagePath).read().convertToFormat(QImage::Format_RGBA8888);
+    if(image.isNull()) return false;
+    return build(pyramidPath, image.width(), image.height(), tileSize, [&](qint64 y, int rows) {
+        return image.copy(0, int(y), image.width(), rows);
+    });
+}
+
+bool QtOpenGLTilePyramid::build(const QString &pyramidPath, qint64 width, qint64 height, int tileSize, const std::function<QImage(qint64 y, int rows)> &readBand)
+{
+    QVector<Level> levels = layout(width, height, tileSize);
+    if(levels.isEmpty() || width > INT_MAX / 4) return false; // bands are QImages
+    const Level &last = levels.last();
+    qint64 tileBytes = qint64(tileSize) * tileSize * 4;
+    qint64 size = last.offset + tileBytes * last.tilesX * last.tilesY;
+    
+    // header
+    QFile file(pyramidPath);
+    if(!file.open(QIODevice::ReadWrite | QIODevice::Truncate)) return false;
+    if(!file.resize(size)) return false; // zero filled, so tile padding is transparent
+    QDataStream out(&file);
+    out << Magic << Version << qint32(tileSize) << qint32(levels.size());
+    for(const Level &level : levels) {
+        out << level.width << level.height << level.tilesX << level.tilesY << level.offset;
+    }
+    if(out.status() != QDataStream::Ok || file.pos() > HeaderSize) return false;
+    uchar *data = file.map(0, size);
+    if(!data) return false;
+    
+    // level 0 from bands of the input
+    const Level &base = levels[0];
+    for(int ty = 0; ty < base.tilesY; ++ty) {
+        qint64 y = qint64(ty) * tileSize;
+        int rows = int(qMin(qint64(tileSize), height - y));
+        QImage band = readBand(y, rows);
+        if(band.width() != width || band.height() != rows || band.format() != QImage::Format_RGBA8888) {
+            file.unmap(data);
+            return false;
+        }
+        for(int tx = 0; tx < base.tilesX; ++tx) {
+            uchar *tile = data + base.offset + (qint64(ty) * base.tilesX + tx) * tileBytes;
+            qint64 x = qint64(tx) * tileSize;
+            int cols = int(qMin(qint64(tileSize), width - x));
+            for(int row = 0; row < rows; ++row) {
+                memcpy(tile + row * tileSize * 4, band.constScanLine(row) + x * 4, cols * 4);
+            }
+        }
+    }
+    
+    // each following level averages 2x2 pixels of the previous one (ignoring padding)
+    for(int i = 1; i < levels.size(); ++i) {
+        const Level &src = levels[i - 1];
+        const Level &dst = levels[i];
+        for(int ty = 0; ty < dst.tilesY; ++ty) {
+            for(int tx = 0; tx < dst.tilesX; ++tx) {
+                uchar *tile = data + dst.offset + (qint64(ty) * dst.tilesX + tx) * tileBytes;
+                for(int row = 0; row < tileSize; ++row) {
+                    qint64 dy = qint64(ty) * tileSize + row;
+                    if(dy >= dst.height) break;
+                    for(int col = 0; col < tileSize; ++col) {
+                        qint64 dx = qint64(tx) * tileSize + col;
+                        if(dx >= dst.width) break;
+                        int sum[4] = {0, 0, 0, 0};
+                        int count = 0;
+                        for(qint64 sy = 2 * dy; sy < qMin(2 * dy + 2, src.height); ++sy) {
+                            for(qint64 sx = 2 * dx; sx < qMin(2 * dx + 2, src.width); ++sx) {
+                                const uchar *srcTile = data + src.offset + ((sy / tileSize) * src.tilesX + sx / tileSize) * tileBytes;
+                                const uchar *pixel = srcTile + ((sy % tileSize) * tileSize + sx % tileSize) * 4;
+                                for(int c = 0; c < 4; ++c) sum[c] += pixel[c];
+                                ++count;
+                            }
+                        }
+                        uchar *pixel = tile + (row * tileSize + col) * 4;
+                        for(int c = 0; c < 4; ++c) pixel[c] = uchar((sum[c] + count / 2) / count);
+                    }
+                }
+            }
+        }
+    }
+    file.unmap(data);
+    return true;
+}
+
+/* --------------------------------------------------------------------------------
+ * Reads a tile from the mapped pyramid file on a worker thread (page faults are
+ * taken here instead of in paintGL) and hands it to the layer on the GUI thread.
+ * -------------------------------------------------------------------------------- */
+class QtOpenGLTileReader : public QRunnable
+{
+public:
+    QtOpenGLTileReader(QtOpenGLImageLayer *layer, const QSharedPointer<QtOpenGLTilePyramid> &pyramid, int generation, quint64 key, int level, int tx, int ty) :
+    _layer(layer), _pyramid(pyramid), _generation(generation), _key(key), _level(level), _tx(tx), _ty(ty) {}
+    
+    void run() Q_DECL_OVERRIDE
+    {
+        const uchar *pixels = _pyramid->tile(_level, _tx, _ty);
+        if(!pixels) return;
+        int tileSize = _pyramid->tileSize();
+        QImage image = QImage(pixels, tileSize, tileSize, tileSize * 4, QImage::Format_RGBA8888).copy();
+        QMetaObject::invokeMethod(_layer, "tileRead", Qt::QueuedConnection, Q_ARG(int, _generation), Q_ARG(quint64, _key), Q_ARG(QImage, image));
+    }
+    
+private:
+    QtOpenGLImageLayer *_layer; // outlives us, the layer waits for its thread pool on close
+    QSharedPointer<QtOpenGLTilePyramid> _pyramid;
+    int _generation;
+    quint64 _key;
+    int _level, _tx, _ty;
+};
+
+QtOpenGLImageLayer::~QtOpenGLImageLayer()
+{
+    close();
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    if(_atlas && _context && context && QOpenGLContext::areSharing(context, _context)) {
+        glDeleteTextures(1, &_atlas);
+    }
+}
+
+bool QtOpenGLImageLayer::open(const QString &pyramidPath)
+{
+    close();
+    QSharedPointer<QtOpenGLTilePyramid> pyramid(new QtOpenGLTilePyramid);
+    if(!pyramid->open(pyramidPath)) return false;
+    _pyramid = pyramid;
+    return true;
+}
+
+void QtOpenGLImageLayer::close()
+{
+    _threadPool.clear();
+    _threadPool.waitForDone();
+    _generation++; // ignore tiles still queued for delivery
+    _pyramid.clear();
+    _pendingTiles.clear();
+    _readTiles.clear();
+    _slotOfTile.clear();
+    _tileInSlot.fill(~quint64(0));
+    _slotLastUsed.fill(0);
+}
+
+QRectF QtOpenGLImageLayer::worldRect() const
+{
+    if(!_pyramid) return QRectF();
+    return QRectF(_position.x(), _position.y(), _pyramid->width() * _pixelSize, _pyramid->height() * _pixelSize);
+}
+
+void QtOpenGLImageLayer::tileRead(int generation, quint64 key, const QImage &image)
+{
+    if(generation != _generation) return;
+    _pendingTiles.remove(key);
+    _readTiles.insert(key, image);
+    emit tileLoaded();
+}
+
+void QtOpenGLImageLayer::setContext(QOpenGLContext *context)
+{
+    if(_context) disconnect(_context, &QOpenGLContext::aboutToBeDestroyed, this, &QtOpenGLImageLayer::contextAboutToBeDestroyed);
+    _context = context;
+    if(_context) connect(_context, &QOpenGLContext::aboutToBeDestroyed, this, &QtOpenGLImageLayer::contextAboutToBeDestroyed);
+}
+
+void QtOpenGLImageLayer::contextAboutToBeDestroyed()
+{
+    // the atlas lives on while another context shares it
+    for(QOpenGLContext *context : _context->shareGroup()->shares()) {
+        if(context != _context) {
+            setContext(context);
+            return;
+        }
+    }
+    // otherwise it goes away with the group, so everything has to be uploaded again
+    setContext(NULL);
+    resetAtlas();
+}
+
+void QtOpenGLImageLayer::resetAtlas()
+{
+    _atlas = 0;
+    _atlasTileSize = 0;
+    _slotOfTile.clear();
+    _tileInSlot.clear();
+    _slotLastUsed.clear();
+}
+
+void QtOpenGLImageLayer::createAtlas()
+{
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    if(context != _context) {
+        // an atlas from another share group can't be used (or deleted) here
+        if(_context && !QOpenGLContext::areSharing(context, _context)) resetAtlas();
+        setContext(context);
+        initializeOpenGLFunctions();
+    }
+    int tileSize = _pyramid->tileSize();
+    if(_atlas && _atlasTileSize == tileSize && _createdAtlasTiles == _atlasTiles) return;
+    if(_atlas) glDeleteTextures(1, &_atlas);
+    GLint maxTextureSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    _atlasSize = qMax(1, qMin(_atlasTiles, maxTextureSize / tileSize));
+    _atlasTileSize = tileSize;
+    _createdAtlasTiles = _atlasTiles;
+    glGenTextures(1, &_atlas);
+    glBindTexture(GL_TEXTURE_2D, _atlas);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, _atlasSize * tileSize, _atlasSize * tileSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    _slotOfTile.clear();
+    _tileInSlot.fill(~quint64(0), _atlasSize * _atlasSize);
+    _slotLastUsed.fill(0, _atlasSize * _atlasSize);
+}
+
+void QtOpenGLImageLayer::uploadTiles()
+{
+    if(_readTiles.isEmpty()) return;
+    glBindTexture(GL_TEXTURE_2D, _atlas);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    for(QHash<quint64, QImage>::const_iterator it = _readTiles.constBegin(); it != _readTiles.constEnd(); ++it) {
+        // least recently used slot (free slots have never been used)
+        int slot = 0;
+        for(int i = 1; i < _slotLastUsed.size(); ++i) {
+            if(_slotLastUsed[i] < _slotLastUsed[slot]) slot = i;
+        }
+        // tiles drawn in the last frame are likely still visible, the rest is read again if needed
+        if(_tileInSlot[slot] != ~quint64(0) && _slotLastUsed[slot] + 1 >= _frame) break;
+        _slotOfTile.remove(_tileInSlot[slot]);
+        _tileInSlot[slot] = it.key();
+        _slotOfTile.insert(it.key(), slot);
+        _slotLastUsed[slot] = _frame;
+        int x = (slot % _atlasSize) * _atlasTileSize;
+        int y = (slot / _atlasSize) * _atlasTileSize;
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, _atlasTileSize, _atlasTileSize, GL_RGBA, GL_UNSIGNED_BYTE, it->constBits());
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    _readTiles.clear();
+}
+
+void QtOpenGLImageLayer::draw(QtOpenGLViewer *viewer)
+{
+    if(!_pyramid) return;
+    createAtlas();
+    connect(this, &QtOpenGLImageLayer::tileLoaded, viewer, static_cast<void (QWidget::*)()>(&QWidget::update), Qt::UniqueConnection);
+    _frame++;
+    uploadTiles();
+    
+    // level matching the current zoom (image pixels per screen pixel)
+    QRectF view = viewer->visibleRect();
+    if(view.isEmpty()) return;
+    double imagePixelsPerScreenPixel = view.width() / (_pixelSize * viewer->width() * viewer->devicePixelRatioF());
+    int targetLevel = imagePixelsPerScreenPixel > 1 ? int(floor(log2(imagePixelsPerScreenPixel))) : 0;
+    targetLevel = qBound(0, targetLevel, _pyramid->levels() - 1);
+    
+    // view in level 0 image pixels (rows go down from the image top)
+    qint64 imageHeight = _pyramid->height();
+    double x0 = (view.left() - _position.x()) / _pixelSize;
+    double x1 = (view.right() - _position.x()) / _pixelSize;
+    double y0 = imageHeight - (view.y() + view.height() - _position.y()) / _pixelSize;
+    double y1 = imageHeight - (view.y() - _position.y()) / _pixelSize;
+    double cx = (x0 + x1) / 2;
+    double cy = (y0 + y1) / 2;
+    
+    // tiles in view per level (none if tx0 > tx1)
+    struct TileRange {
+        int tx0, tx1, ty0, ty1;
+    };
+    QVector<TileRange> ranges(_pyramid->levels());
+    for(int level = 0; level < ranges.size(); ++level) {
+        double tilePixels = double(_atlasTileSize) * (qint64(1) << level);
+        // clamp as doubles, the view can be far away from the image
+        double lastX = _pyramid->tilesX(level) - 1;
+        double lastY = _pyramid->tilesY(level) - 1;
+        TileRange range = {0, -1, 0, -1};
+        if(x1 >= 0 && y1 >= 0 && x0 / tilePixels < lastX + 1 && y0 / tilePixels < lastY + 1) {
+            range.tx0 = int(qBound(0.0, floor(x0 / tilePixels), lastX));
+            range.tx1 = int(qBound(0.0, floor(x1 / tilePixels), lastX));
+            range.ty0 = int(qBound(0.0, floor(y0 / tilePixels), lastY));
+            range.ty1 = int(qBound(0.0, floor(y1 / tilePixels), lastY));
+        }
+        ranges[level] = range;
+    }
+    
+    // go coarser until all drawn tiles fit in the atlas, otherwise visible tiles evict each other every frame
+    for(qint64 tiles = 0; ; tiles = 0) {
+        for(int level = targetLevel; level < ranges.size(); ++level) {
+            tiles += qint64(ranges[level].tx1 - ranges[level].tx0 + 1) * (ranges[level].ty1 - ranges[level].ty0 + 1);
+        }
+        if(tiles <= _atlasSize * _atlasSize || targetLevel + 1 == ranges.size()) break;
+        targetLevel++;
+    }
+    
+    glPushAttrib(GL_ENABLE_BIT);
+    glPushAttrib(GL_COLOR_BUFFER_BIT);
+    glPushAttrib(GL_CURRENT_BIT);
+    glPushAttrib(GL_TEXTURE_BIT);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_LIGHTING);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, _atlas);
+    glColor4f(1, 1, 1, 1);
+    
+    // draw coarse to fine so finer tiles cover coarser ones, request what's missing
+    struct TileRequest {
+        int level, tx, ty;
+        double distance;
+    };
+    QVector<TileRequest> requests;
+    for(int level = _pyramid->levels() - 1; level >= targetLevel; --level) {
+        double tilePixels = double(_atlasTileSize) * (qint64(1) << level);
+        const TileRange &range = ranges[level];
+        for(int ty = range.ty0; ty <= range.ty1; ++ty) {
+            for(int tx = range.tx0; tx <= range.tx1; ++tx) {
+                quint64 key = tileKey(level, tx, ty);
+                QHash<quint64, int>::const_iterator it = _slotOfTile.constFind(key);
+                if(it != _slotOfTile.constEnd()) {
+                    _slotLastUsed[*it] = _frame;
+                    drawTile(level, tx, ty, *it);
+                } else if(!_pendingTiles.contains(key)) {
+                    double dx = (tx + 0.5) * tilePixels - cx;
+                    double dy = (ty + 0.5) * tilePixels - cy;
+                    TileRequest request = {level, tx, ty, dx * dx + dy * dy};
+                    requests.append(request);
+                }
+            }
+        }
+    }
+    
+    glPopAttrib(); // GL_TEXTURE_BIT
+    glPopAttrib(); // GL_CURRENT_BIT
+    glPopAttrib(); // GL_COLOR_BUFFER_BIT
+    glPopAttrib(); // GL_ENABLE_BIT
+    
+    // coarser levels first so there is always something to show, then nearest to view center
+    std::sort(requests.begin(), requests.end(), [](const TileRequest &a, const TileRequest &b) {
+        return a.level != b.level ? a.level > b.level : a.distance < b.distance;
+    });
+    for(const TileRequest &request : requests) {
+        if(_pendingTiles.size() >= _maxPendingTiles) break;
+        quint64 key = tileKey(request.level, request.tx, request.ty);
+        _pendingTiles.insert(key);
+        _threadPool.start(new QtOpenGLTileReader(this, _pyramid, _generation, key, request.level, request.tx, request.ty));
+    }
+}
+
+void QtOpenGLImageLayer::drawTile(int level, int tx, int ty, int slot)
+{
+    // tile quad in world coordinates (tile row 0 is at the top)
+    float tileWorldSize = _atlasTileSize * float(qint64(1) << level) * _pixelSize;
+    float left = _position.x() + tx * tileWorldSize;
+    float top = _position.y() + _pyramid->height() * _pixelSize - ty * tileWorldSize;
+    float right = left + tileWorldSize;
+    float bottom = top - tileWorldSize;
+    // atlas texture coordinates inset by half a texel to avoid bleeding from neighbouring slots
+    float atlasPixels = _atlasSize * _atlasTileSize;
+    float u0 = ((slot % _atlasSize) * _atlasTileSize + 0.5) / atlasPixels;
+    float v0 = ((slot / _atlasSize) * _atlasTileSize + 0.5) / atlasPixels;
+    float u1 = u0 + (_atlasTileSize - 1) / atlasPixels;
+    float v1 = v0 + (_atlasTileSize - 1) / atlasPixels;
+    glBegin(GL_QUADS);
+    glTexCoord2f(u0, v0); glVertex3f(left, top, 0);
+    glTexCoord2f(u0, v1); glVertex3f(left, bottom, 0);
+    glTexCoord2f(u1, v1); glVertex3f(right, bottom, 0);
+    glTexCoord2f(u1, v0); glVertex3f(right, top, 0);
+    glEnd();
+}
+
+void QtOpenGLTimeSeriesLayer::setCapacity(qint64 n)
+{
+    _capacity = n > 0 ? n : 0;
+    if(_capacity > 0 && size() > _capacity) {
+        dropOldest(size() - _capacity);
+        _revision++;
+    }
+}
+
+void QtOpenGLTimeSeriesLayer::clear()
+{
+    _samples.clear();
+    _levels.clear();
+    _first = 0;
+    _revision++;
+}
+
+void QtOpenGLTimeSeriesLayer::append(const float *samples, qint64 count)
+{
+    if(count <= 0) return;
+    qint64 from = _first + size();
+    _samples.insert(_samples.end(), samples, samples + count);
+    updateLevels(from);
+    if(_capacity > 0 && size() > _capacity) dropOldest(size() - _capacity);
+    _revision++;
+}
+
+void QtOpenGLTimeSeriesLayer::updateBucket(int level, qint64 bucket)
+{
+    float lo = 0, hi = 0;
+    bool any = false;
+    if(level == 0) {
+        qint64 i0 = qMax(bucket * BaseBucketSize, _first);
+        qint64 i1 = qMin((bucket + 1) * BaseBucketSize, _first + size());
+        for(qint64 i = i0; i < i1; ++i) {
+            float value = _samples[i - _first];
+            if(!any || value < lo) lo = value;
+            if(!any || value > hi) hi = value;
+            any = true;
+        }
+    } else {
+        const Level &finer = _levels[level - 1];
+        for(qint64 b = 2 * bucket; b < 2 * bucket + 2; ++b) {
+            qint64 i = b - finer.first;
+            if(i < 0 || i >= qint64(finer.min.size())) continue;
+            if(!any || finer.min[i] < lo) lo = finer.min[i];
+            if(!any || finer.max[i] > hi) hi = finer.max[i];
+            any = true;
+        }
+    }
+    if(!any) return;
+    Level &summary = _levels[level];
+    qint64 i = bucket - summary.first;
+    if(i == qint64(summary.min.size())) {
+        summary.min.push_back(lo);
+        summary.max.push_back(hi);
+    } else {
+        summary.min[i] = lo;
+        summary.max[i] = hi;
+    }
+}
+
+void QtOpenGLTimeSeriesLayer::updateLevels(qint64 fromIndex)
+{
+    // only buckets touched by samples from fromIndex on change
+    qint64 end = _first + size();
+    for(int level = 0; ; ++level) {
+        qint64 n = bucketSize(level);
+        qint64 levelFrom = fromIndex;
+        if(level == _levels.size()) {
+            if(size() < 2 * n) break; // a level is only useful once it has a few buckets
+            Level summary;
+            summary.first = _first / n;
+            _levels.append(summary);
+            levelFrom = _first;
+        }
+        for(qint64 bucket = levelFrom / n; bucket <= (end - 1) / n; ++bucket) {
+            updateBucket(level, bucket);
+        }
+    }
+}
+
+void QtOpenGLTimeSeriesLayer::dropOldest(qint64 count)
+{
+    count = qMin(count, size());
+    _samples.erase(_samples.begin(), _samples.begin() + count);
+    _first += count;
+    for(int level = 0; level < _levels.size(); ++level) {
+        Level &summary = _levels[level];
+        qint64 dropped = qMin(_first / bucketSize(level) - summary.first, qint64(summary.min.size()));
+        if(dropped > 0) {
+            summary.min.erase(summary.min.begin(), summary.min.begin() + dropped);
+            summary.max.erase(summary.max.begin(), summary.max.begin() + dropped);
+            summary.first += dropped;
+        }
+        // first bucket may now be partial
+        if(!summary.min.empty()) updateBucket(level, summary.first);
+    }
+}
+
+void QtOpenGLTimeSeriesLayer::draw(QtOpenGLViewer *viewer)
+{
+    if(_samples.empty()) return;
+    if(!_lineBuffer.isCreated()) {
+        initializeOpenGLFunctions();
+        _lineBuffer.create();
+        _lineBuffer.setUsagePattern(QOpenGLBuffer::StreamDraw);
+    }
+    QRectF view = viewer->visibleRect();
+    double pixels = viewer->width() * viewer->devicePixelRatioF();
+    if(view.isEmpty() || pixels < 1) return;
+    
+    // visible samples (plus one either side so the line runs off screen)
+    qint64 end = _first + size();
+    double left = qBound(double(_first), floor((view.left() - _startX) / _sampleInterval) - 1, double(end));
+    double right = qBound(double(_first), ceil((view.right() - _startX) / _sampleInterval) + 2, double(end));
+    qint64 start = qint64(left);
+    qint64 stop = qint64(right);
+    if(stop - start < 2) return;
+    
+    // coarsest level with buckets no wider than a pixel column (-1 = raw samples)
+    double samplesPerPixel = view.width() / _sampleInterval / pixels;
+    int level = -1;
+    while(level + 1 < _levels.size() && bucketSize(level + 1) <= samplesPerPixel) {
+        ++level;
+    }
+    
+    // refill the line buffer only if the view or data changed (x relative to start in samples)
+    if(start != _drawnStart || stop != _drawnEnd || level != _drawnLevel || _revision != _drawnRevision) {
+        _vertices.clear();
+        if(level < 0) {
+            for(qint64 i = start; i < stop; ++i) {
+                _vertices.append(float(i - start));
+                _vertices.append(_samples[i - _first]);
+            }
+        } else {
+            // vertical min-max segment per bucket
+            const Level &summary = _levels[level];
+            qint64 n = bucketSize(level);
+            qint64 b0 = qMax(start / n, summary.first);
+            qint64 b1 = qMin((stop - 1) / n, summary.first + qint64(summary.min.size()) - 1);
+            for(qint64 b = b0; b <= b1; ++b) {
+                float x = float(b * n + n / 2 - start);
+                _vertices.append(x);
+                _vertices.append(summary.min[b - summary.first]);
+                _vertices.append(x);
+                _vertices.append(summary.max[b - summary.first]);
+            }
+        }
+        _lineBuffer.bind();
+        _lineBuffer.allocate(_vertices.constData(), _vertices.size() * int(sizeof(float)));
+        _lineBuffer.release();
+        _drawnStart = start;
+        _drawnEnd = stop;
+        _drawnLevel = level;
+        _drawnRevision = _revision;
+    }
+    if(_vertices.size() < 4) return;
+    
+    glPushAttrib(GL_ENABLE_BIT);
+    glPushAttrib(GL_CURRENT_BIT);
+    glPushAttrib(GL_LINE_BIT);
+    glDisable(GL_LIGHTING);
+    glLineWidth(_lineWidth);
+    glColor4f(_color.redF(), _color.greenF(), _color.blueF(), _color.alphaF());
+    glPushMatrix();
+    glTranslated(_startX + _drawnStart * _sampleInterval, 0, 0);
+    glScaled(_sampleInterval, 1, 1);
+    _lineBuffer.bind();
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(2, GL_FLOAT, 0, 0);
+    glDrawArrays(GL_LINE_STRIP, 0, _vertices.size() / 2);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    _lineBuffer.release();
+    glPopMatrix();
+    glPopAttrib(); // GL_LINE_BIT
+    glPopAttrib(); // GL_CURRENT_BIT
+    glPopAttrib(); // GL_ENABLE_BIT
+}
+
+bool QtOpenGLInputRecorder::start(const QString &path)
+{
+    stop();
+    _file.setFileName(path);
+    if(!_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+    _stream.setDevice(&_file);
+    _stream.setVersion(QDataStream::Qt_5_0);
+    _stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    _stream << Magic << Version;
+    _clock.start();
+    _lastNsecs = 0;
+    _count = 0;
+    return true;
+}
+
+void QtOpenGLInputRecorder::stop()
+{
+    if(!_file.isOpen()) return;
+    _stream.setDevice(NULL);
+    _file.close();
+}
+
+bool QtOpenGLInputRecorder::isRecordable(QEvent::Type type)
+{
+    switch(type) {
+        case QEvent::MouseButtonPress:
+        case QEvent::MouseButtonRelease:
+        case QEvent::MouseButtonDblClick:
+        case QEvent::MouseMove:
+        case QEvent::Wheel:
+        case QEvent::KeyPress:
+        case QEvent::KeyRelease:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void QtOpenGLInputRecorder::record(const QEvent *event)
+{
+    if(!isRecording() || !isRecordable(event->type())) return;
+    // microseconds since the previous event
+    qint64 nsecs = _clock.nsecsElapsed();
+    quint32 usecs = quint32(qMin((nsecs - _lastNsecs) / 1000, qint64(0xFFFFFFFF)));
+    _lastNsecs += qint64(usecs) * 1000;
+    // modifiers all live in the top byte
+    quint8 modifiers = quint8(int(static_cast<const QInputEvent*>(event)->modifiers()) >> 24);
+    _stream << usecs << quint8(event->type()) << modifiers;
+    if(event->type() == QEvent::Wheel) {
+        const QWheelEvent *wheel = static_cast<const QWheelEvent*>(event);
+#if QT_VERSION >= 0x050E00
+        QPointF pos = wheel->position();
+#else
+        QPointF pos = wheel->posF();
+#endif
+        _stream << float(pos.x()) << float(pos.y()) << quint16(wheel->buttons())
+                << qint16(wheel->angleDelta().x()) << qint16(wheel->angleDelta().y())
+                << qint16(wheel->pixelDelta().x()) << qint16(wheel->pixelDelta().y());
+    } else if(event->type() == QEvent::KeyPress || event->type() == QEvent::KeyRelease) {
+        const QKeyEvent *key = static_cast<const QKeyEvent*>(event);
+        _stream << qint32(key->key()) << key->text() << quint8(key->isAutoRepeat()) << quint16(key->count());
+    } else {
+        const QMouseEvent *mouse = static_cast<const QMouseEvent*>(event);
+        _stream << float(mouse->localPos().x()) << float(mouse->localPos().y()) << quint16(mouse->button()) << quint16(mouse->buttons());
+    }
+    _count++;
+}
+
+int QtOpenGLInputReplayer::replay(const QString &path, QWidget *widget, Speed speed)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly)) return -1;
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+    in.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    quint32 magic = 0, version = 0;
+    in >> magic >> version;
+    if(in.status() != QDataStream::Ok || magic != QtOpenGLInputRecorder::Magic || version != QtOpenGLInputRecorder::Version) return -1;
+    QtOpenGLViewer *viewer = qobject_cast<QtOpenGLViewer*>(widget);
+    QPointF windowOffset = widget->mapTo(widget->window(), QPoint(0, 0));
+    QPointF screenOffset = widget->mapToGlobal(QPoint(0, 0));
+    QElapsedTimer clock;
+    clock.start();
+    qint64 eventNsecs = 0;
+    int count = 0;
+    while(!in.atEnd()) {
+        quint32 usecs = 0;
+        quint8 type = 0, modifierBits = 0;
+        in >> usecs >> type >> modifierBits;
+        Qt::KeyboardModifiers modifiers(QFlag(int(modifierBits) << 24));
+        QScopedPointer<QEvent> event;
+        if(type == QEvent::Wheel) {
+            float x = 0, y = 0;
+            quint16 buttons = 0;
+            qint16 angleX = 0, angleY = 0, pixelX = 0, pixelY = 0;
+            in >> x >> y >> buttons >> angleX >> angleY >> pixelX >> pixelY;
+            QPointF pos(x, y);
+#if QT_VERSION >= 0x050C00
+            event.reset(new QWheelEvent(pos, screenOffset + pos, QPoint(pixelX, pixelY), QPoint(angleX, angleY), Qt::MouseButtons(QFlag(buttons)), modifiers, Qt::NoScrollPhase, false));
+#else
+            event.reset(new QWheelEvent(pos, screenOffset + pos, QPoint(pixelX, pixelY), QPoint(angleX, angleY), angleY, Qt::Vertical, Qt::MouseButtons(QFlag(buttons)), modifiers));
+#endif
+        } else if(type == QEvent::KeyPress || type == QEvent::KeyRelease) {
+            qint32 key = 0;
+            QString text;
+            quint8 autoRepeat = 0;
+            quint16 repeatCount = 0;
+            in >> key >> text >> autoRepeat >> repeatCount;
+            event.reset(new QKeyEvent(QEvent::Type(type), key, modifiers, text, autoRepeat, repeatCount));
+        } else if(QtOpenGLInputRecorder::isRecordable(QEvent::Type(type))) {
+            float x = 0, y = 0;
+            quint16 button = 0, buttons = 0;
+            in >> x >> y >> button >> buttons;
+            QPointF pos(x, y);
+            event.reset(new QMouseEvent(QEvent::Type(type), pos, windowOffset + pos, screenOffset + pos, Qt::MouseButton(button), Qt::MouseButtons(QFlag(buttons)), modifiers));
+        }
+        if(in.status() != QDataStream::Ok || !event) break;
+        eventNsecs += qint64(usecs) * 1000;
+        if(speed == OriginalSpeed) {
+            while(clock.nsecsElapsed() < eventNsecs) {
+                QCoreApplication::processEvents();
+                if(eventNsecs - clock.nsecsElapsed() > 2000000) QThread::msleep(1);
+            }
+        }
+        quint64 frameRequests = viewer ? viewer->frameRequests() : 0;
+        QCoreApplication::sendEvent(widget, event.data());
+        if(viewer && !viewer->isVisible() && viewer->frameRequests() != frameRequests) viewer->grabFramebuffer(); // offscreen, repaint() won't render
+        QCoreApplication::processEvents(); // render any update() requests
+        count++;
+    }
+    return count;
+}
+
+void QtOpenGLLatencyHistogram::clear()
+{
+    _bins.fill(0, BinsPerDecade * Decades + 2);
+    _count = 0;
+    _sumNsecs = 0;
+    _maxNsecs = 0;
+}
+
+void QtOpenGLLatencyHistogram::add(qint64 nsecs)
+{
+    int bin = 0;
+    if(nsecs >= 10000) bin = qMin(1 + int(floor(log10(nsecs / 1e4) * BinsPerDecade)), _bins.size() - 1);
+    _bins[bin]++;
+    _count++;
+    _sumNsecs += nsecs;
+    if(nsecs > _maxNsecs) _maxNsecs = nsecs;
+}
+
+double QtOpenGLLatencyHistogram::binUpperNsecs(int bin)
+{
+    return 1e4 * pow(10, double(bin) / BinsPerDecade);
+}
+
+double QtOpenGLLatencyHistogram::percentileMsecs(double percent) const
+{
+    if(!_count) return 0;
+    qint64 rank = qMax(qint64(1), qint64(ceil(percent / 100 * _count)));
+    qint64 cumulative = 0;
+    for(int bin = 0; bin < _bins.size(); ++bin) {
+        cumulative += _bins[bin];
+        if(cumulative >= rank) {
+            // the last bin has no upper edge
+            return bin + 1 < _bins.size() ? qMin(binUpperNsecs(bin), double(_maxNsecs)) / 1e6 : maxMsecs();
+        }
+    }
+    return maxMsecs();
+}
+
+QString QtOpenGLLatencyHistogram::toString() const
+{
+    return QString("n=%1 mean=%2ms p50=%3ms p90=%4ms p99=%5ms max=%6ms")
+    .arg(_count).arg(meanMsecs(), 0, 'f', 2).arg(percentileMsecs(50), 0, 'f', 2).arg(percentileMsecs(90), 0, 'f', 2)
+    .arg(percentileMsecs(99), 0, 'f', 2).arg(maxMsecs(), 0, 'f', 2);
+}
+
+bool QtOpenGLLatencyHistogram::save(const QString &path) const
+{
+    // text so histograms from different builds are easy to diff or plot
+    QFile file(path);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) return false;
+    QTextStream out(&file);
+    out << "count,sum_ns,max_ns\n" << _count << "," << qint64(_sumNsecs) << "," << _maxNsecs << "\n";
+    out << "bin_upper_ms,count\n";
+    for(int bin = 0; bin < _bins.size(); ++bin) {
+        out << (bin + 1 < _bins.size() ? binUpperNsecs(bin) / 1e6 : -1) << "," << _bins[bin] << "\n";
+    }
+    return out.status() == QTextStream::Ok;
+}
+
+bool QtOpenGLLatencyHistogram::load(const QString &path)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly | QIODevice::Text)) return false;
+    QTextStream in(&file);
+    in.readLine();
+    QStringList totals = in.readLine().split(",");
+    in.readLine();
+    if(totals.size() != 3) return false;
+    clear();
+    for(int bin = 0; bin < _bins.size() && !in.atEnd(); ++bin) {
+        QStringList fields = in.readLine().split(",");
+        if(fields.size() == 2) _bins[bin] = fields[1].toLongLong();
+    }
+    _count = totals[0].toLongLong();
+    _sumNsecs = totals[1].toDouble();
+    _maxNsecs = totals[2].toLongLong();
+    return true;
+}
+
+QString QtOpenGLLatencyHistogram::compare(const QtOpenGLLatencyHistogram &baseline, const QtOpenGLLatencyHistogram &current)
+{
+    QString text;
+    QStringList names = QStringList() << "mean" << "p50" << "p90" << "p99" << "max";
+    double a[5] = {baseline.meanMsecs(), baseline.percentileMsecs(50), baseline.percentileMsecs(90), baseline.percentileMsecs(99), baseline.maxMsecs()};
+    double b[5] = {current.meanMsecs(), current.percentileMsecs(50), current.percentileMsecs(90), current.percentileMsecs(99), current.maxMsecs()};
+    for(int i = 0; i < 5; ++i) {
+        double change = a[i] > 0 ? (b[i] - a[i]) / a[i] * 100 : 0;
+        text += QString("%1: %2ms -> %3ms (%4%5%)\n").arg(names[i], 4).arg(a[i], 0, 'f', 2).arg(b[i], 0, 'f', 2).arg(change >= 0 ? "+" : "").arg(change, 0, 'f', 1);
+    }
+    return text;
+}
+
+static const char *scalarFieldVertexShader =
+    "#version 120\n"
+    "attribute float scalar;\n"
+    "varying float value;\n"
+    "void main() {\n"
+    "    value = scalar;\n"
+    "    gl_Position = gl_ModelViewProjectionMatrix * gl_Vertex;\n"
+    "}\n";
+
+static const char *scalarFieldFragmentShader =
+    "#version 120\n"
+    "uniform sampler2D colormap;\n"
+    "uniform float rangeOffset;\n"
+    "uniform float rangeScale;\n"
+    "uniform bool logScale;\n"
+    "uniform bool clampRange;\n"
+    "varying float value;\n"
+    "void main() {\n"
+    "    float v = logScale ? log(max(value, 1e-30)) : value;\n"
+    "    float t = (v - rangeOffset) * rangeScale;\n"
+    "    if(!clampRange && (t < 0.0 || t > 1.0)) discard;\n"
+    "    // sample texel centers of the 256 entry colormap\n"
+    "    gl_FragColor = texture2D(colormap, vec2(clamp(t, 0.0, 1.0) * (255.0 / 256.0) + 0.5 / 256.0, 0.5));\n"
+    "}\n";
+
+static QByteArray scalarFieldProgramKey()
+{
+    QByteArray sources = QByteArray(scalarFieldVertexShader) + scalarFieldFragmentShader;
+    return QtOpenGLResourcePool::contentKey(sources.constData(), sources.size());
+}
+
+QtOpenGLScalarField::~QtOpenGLScalarField()
+{
+    // pooled resources can only be released with a context in their group current
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    if(_context && context && QOpenGLContext::areSharing(context, _context)) {
+        QtOpenGLResourcePool &pool = QtOpenGLResourcePool::instance();
+        if(_program) pool.release(scalarFieldProgramKey());
+        if(_colormapTexture) pool.release(colormapKey(_textureColormap));
+    }
+}
+
+void QtOpenGLScalarField::setPositions(const float *xyz, int vertexCount)
+{
+    _positions = QVector<float>(3 * vertexCount);
+    memcpy(_positions.data(), xyz, 3 * vertexCount * sizeof(float));
+    _vertexCount = vertexCount;
+    _positionsUploaded = false;
+}
+
+void QtOpenGLScalarField::setScalars(const float *values, int vertexCount)
+{
+    _scalars = QVector<float>(vertexCount);
+    memcpy(_scalars.data(), values, vertexCount * sizeof(float));
+    _scalarCount = vertexCount;
+    _scalarsUploaded = false;
+}
+
+void QtOpenGLScalarField::setIndices(const GLuint *indices, int count)
+{
+    _indices = QVector<GLuint>(count);
+    memcpy(_indices.data(), indices, count * sizeof(GLuint));
+    _indexCount = count;
+    _indicesUploaded = false;
+}
+
+QImage QtOpenGLScalarField::colormapImage(Colormap map)
+{
+    // control points (position, r, g, b) linearly interpolated
+    static const float gray[] = {0, 0, 0, 0, 1, 255, 255, 255};
+    static const float viridis[] = {
+        0, 68, 1, 84,  0.125, 71, 44, 122,  0.25, 59, 81, 139,  0.375, 44, 113, 142,  0.5, 33, 144, 141,
+        0.625, 39, 173, 129,  0.75, 92, 200, 99,  0.875, 170, 220, 50,  1, 253, 231, 37
+    };
+    static const float jet[] = {0, 0, 0, 128,  0.125, 0, 0, 255,  0.375, 0, 255, 255,  0.625, 255, 255, 0,  0.875, 255, 0, 0,  1, 128, 0, 0};
+    static const float hot[] = {0, 0, 0, 0,  0.375, 255, 0, 0,  0.75, 255, 255, 0,  1, 255, 255, 255};
+    static const float coolWarm[] = {0, 59, 76, 192,  0.5, 221, 221, 221,  1, 180, 4, 38};
+    const float *points = viridis;
+    int n = sizeof(viridis) / sizeof(float) / 4;
+    switch(map) {
+        case Gray: points = gray; n = sizeof(gray) / sizeof(float) / 4; break;
+        case Viridis: break;
+        case Jet: points = jet; n = sizeof(jet) / sizeof(float) / 4; break;
+        case Hot: points = hot; n = sizeof(hot) / sizeof(float) / 4; break;
+        case CoolWarm: points = coolWarm; n = sizeof(coolWarm) / sizeof(float) / 4; break;
+    }
+    QImage image(256, 1, QImage::Format_RGBA8888);
+    int j = 0;
+    for(int i = 0; i < 256; ++i) {
+        float t = i / 255.0;
+        while(j < n - 2 && t > points[4 * (j + 1)]) ++j;
+        const float *a = points + 4 * j;
+        const float *b = a + 4;
+        float s = (t - a[0]) / (b[0] - a[0]);
+        image.setPixel(i, 0, qRgb(qRound(a[1] + s * (b[1] - a[1])), qRound(a[2] + s * (b[2] - a[2])), qRound(a[3] + s * (b[3] - a[3]))));
+    }
+    return image;
+}
+
+QByteArray QtOpenGLScalarField::colormapKey(Colormap map)
+{
+    return "QtOpenGLScalarField::colormap:" + QByteArray::number(int(map));
+}
+
+void QtOpenGLScalarField::setContext(QOpenGLContext *context)
+{
+    if(_context) disconnect(_context, &QOpenGLContext::aboutToBeDestroyed, this, &QtOpenGLScalarField::contextAboutToBeDestroyed);
+    _context = context;
+    if(_context) connect(_context, &QOpenGLContext::aboutToBeDestroyed, this, &QtOpenGLScalarField::contextAboutToBeDestroyed);
+}
+
+void QtOpenGLScalarField::contextAboutToBeDestroyed()
+{
+    // the GPU data lives on while another context shares it
+    for(QOpenGLContext *context : _context->shareGroup()->shares()) {
+        if(context != _context) {
+            setContext(context);
+            return;
+        }
+    }
+    // otherwise it goes away with the group (the pool deletes the program and colormap)
+    setContext(NULL);
+    resetGL();
+}
+
+void QtOpenGLScalarField::resetGL()
+{
+    // buffers are only queued for deletion in their own group, nothing here needs a context
+    _positionBuffer.destroy();
+    _scalarBuffer.destroy();
+    _indexBuffer.destroy();
+    _program = NULL;
+    _colormapTexture = NULL;
+    _positionsUploaded = false;
+    _scalarsUploaded = false;
+    _indicesUploaded = false;
+}
+
+void QtOpenGLScalarField::draw(GLenum mode)
+{
+    QtOpenGLResourcePool &pool = QtOpenGLResourcePool::instance();
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    if(context != _context) {
+        // GPU data from another share group can't be used here, its pool references stay with that group
+        if(_context && !QOpenGLContext::areSharing(context, _context)) resetGL();
+        setContext(context);
+        initializeOpenGLFunctions();
+    }
+    if(!_program) _program = pool.acquireProgram(scalarFieldProgramKey(), scalarFieldVertexShader, scalarFieldFragmentShader);
+    
+    // upload vertex data that changed since the last draw
+    if(!_positionsUploaded) {
+        if(!_positionBuffer.isCreated()) _positionBuffer.create();
+        _positionBuffer.bind();
+        _positionBuffer.allocate(_positions.constData(), _positions.size() * int(sizeof(float)));
+        _positionsUploaded = true;
+    }
+    if(!_scalarsUploaded) {
+        if(!_scalarBuffer.isCreated()) _scalarBuffer.create();
+        _scalarBuffer.bind();
+        _scalarBuffer.allocate(_scalars.constData(), _scalars.size() * int(sizeof(float)));
+        _scalarsUploaded = true;
+    }
+    if(!_indicesUploaded) {
+        if(!_indexBuffer.isCreated()) _indexBuffer.create();
+        _indexBuffer.bind();
+        _indexBuffer.allocate(_indices.constData(), _indices.size() * int(sizeof(GLuint)));
+        _indicesUploaded = true;
+    }
+    QOpenGLBuffer::release(QOpenGLBuffer::VertexBuffer);
+    QOpenGLBuffer::release(QOpenGLBuffer::IndexBuffer);
+    if(_vertexCount == 0 || _scalarCount != _vertexCount) return;
+    
+    // colormap textures are shared through the pool
+    if(!_colormapTexture || _textureColormap != _colormap) {
+        QOpenGLTexture *texture = pool.acquireTexture(colormapKey(_colormap), colormapImage(_colormap));
+        texture->setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
+        texture->setWrapMode(QOpenGLTexture::ClampToEdge);
+        if(_colormapTexture) pool.release(colormapKey(_textureColormap));
+        _colormapTexture = texture;
+        _textureColormap = _colormap;
+    }
+    
+    // range uniforms, t = (value - offset) * scale
+    float lo = _rangeMin, hi = _rangeMax;
+    if(_logScale) {
+        lo = log(qMax(lo, 1e-30f));
+        hi = log(qMax(hi, 1e-30f));
+    }
+    float scale = hi != lo ? 1 / (hi - lo) : 0;
+    
+    glPushAttrib(GL_ENABLE_BIT);
+    glDisable(GL_LIGHTING);
+    _program->bind();
+    _program->setUniformValue("colormap", 0);
+    _program->setUniformValue("rangeOffset", lo);
+    _program->setUniformValue("rangeScale", scale);
+    _program->setUniformValue("logScale", _logScale);
+    _program->setUniformValue("clampRange", _clampRange);
+    glActiveTexture(GL_TEXTURE0);
+    _colormapTexture->bind();
+    _positionBuffer.bind();
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, 0);
+    _scalarBuffer.bind();
+    _program->enableAttributeArray("scalar");
+    _program->setAttributeBuffer("scalar", GL_FLOAT, 0, 1);
+    if(_indexCount) {
+        _indexBuffer.bind();
+        glDrawElements(mode, _indexCount, GL_UNSIGNED_INT, 0);
+        _indexBuffer.release();
+    } else {
+        glDrawArrays(mode, 0, _vertexCount);
+    }
+    _program->disableAttributeArray("scalar");
+    glDisableClientState(GL_VERTEX_ARRAY);
+    _scalarBuffer.release();
+    _colormapTexture->release();
+    _program->release();
+    glPopAttrib(); // GL_ENABLE_BIT
+}
@@ -7,12 +7,36 @@
 #ifndef __QtOpenGLViewer_H__
 #define __QtOpenGLViewer_H__
 
+#include <deque>
+#include <functional>
+
+#include <QByteArray>
 #include <QColor>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QEvent>
+#include <QFile>
 #include <QFont>
+#include <QHash>
+#include <QImage>
+#include <QList>
 #include <QObject>
+#include <QOpenGLBuffer>
+#include <QOpenGLContext>
 #include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLTexture>
 #include <QOpenGLWidget>
 #include <QPainter>
+#include <QPair>
+#include <QPointF>
+#include <QRectF>
+#include <QSet>
+#include <QSharedPointer>
+#include <QString>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
 #include <QVector3D>
 
 #ifdef DEBUG
@@ -20,6 +44,9 @@
 #include <QDebug>
 #endif
 
+class QtOpenGLInputRecorder;
+class QtOpenGLLatencyHistogram;
+
 /* --------------------------------------------------------------------------------
  * Graph viewer UI.
  * -------------------------------------------------------------------------------- */
@@ -34,13 +61,13 @@ class QtOpenGLViewer : public QOpenGLWidget, protected QOpenGLFunctions
     
 public:
     QtOpenGLViewer(QWidget *parent = NULL) : QOpenGLWidget(parent) {}
-    virtual ~QtOpenGLViewer() {}
+    virtual ~QtOpenGLViewer() { unlinkCamera(); }
     
     struct Camera {
         QVector3D eye = QVector3D(0, 0, 10);
         QVector3D center = QVector3D(0, 0, 0);
         QVector3D up = QVector3D(0, 1, 0);
-        QVector3D view() { return center - eye; }
+        QVector3D view() const { return center - eye; }
         void zoom(float viewDistance) { eye = center - view().normalized() * viewDistance; }
     } camera;
     
@@ -59,6 +86,32 @@ public:
     QFont hudFont() const { return _hudFont; }
     void setHudFont(const QFont &font) { _hudFont = font; }
     
+    // nanoseconds from initializeGL() to the end of the first paintGL() (-1 until then)
+    qint64 startupNsecs() const { return _startupNsecs; }
+    
+    // ortho view box relative to the eye (sized relative to zoom distance)
+    void getOrthoBox(float &left, float &right, float &bottom, float &top, float &near, float &far) const;
+    
+    // world region in view for 2D (x = left, y = bottom, width and height extend right and up)
+    QRectF visibleRect() const;
+    
+    // input recording and input-to-frame latency measurement (not owned, NULL = off)
+    QtOpenGLInputRecorder *inputRecorder() const { return _inputRecorder; }
+    void setInputRecorder(QtOpenGLInputRecorder *recorder) { _inputRecorder = recorder; }
+    QtOpenGLLatencyHistogram *latencyHistogram() const { return _latencyHistogram; }
+    void setLatencyHistogram(QtOpenGLLatencyHistogram *histogram);
+    
+    // Redraw now. Input handlers should use this rather than repaint() or update(), only
+    // input that requests a frame this way is measured by the latency histogram.
+    void requestFrame();
+    quint64 frameRequests() const { return _frameRequests; }
+    
+    // camera linking (all viewers in a linked group follow each other's camera)
+    void linkCamera(QtOpenGLViewer *viewer);
+    void unlinkCamera();
+    QList<QtOpenGLViewer*> linkedViewers() const;
+    void syncLinkedCameras();
+    
     // useful stuff
     static QVector3D screen2World(QVector3D screen, int *viewport, float *projection, float *modelview);
     static QVector3D world2Screen(QVector3D world, int *viewport, float *projection, float *modelview);
@@ -82,6 +135,7 @@ public:
     
 signals:
     void optionsChanged();
+    void cameraChanged();
     void selectedObjectChanged(QObject*);
     
 public slots:
@@ -94,6 +148,7 @@ protected:
     void resizeGL(int w, int h) Q_DECL_OVERRIDE;
     void paintGL() Q_DECL_OVERRIDE;
     
+    bool event(QEvent *event) Q_DECL_OVERRIDE;
     virtual void keyPressEvent(QKeyEvent *event) Q_DECL_OVERRIDE;
     virtual void mousePressEvent(QMouseEvent *event) Q_DECL_OVERRIDE;
     virtual void mouseReleaseEvent(QMouseEvent *event) Q_DECL_OVERRIDE;
@@ -109,6 +164,528 @@ protected:
     QFont _hudFont = QFont("Sans", 10, QFont::Normal);
     QPoint _mousePosition;
     QObject *_selectedObject = NULL;
+    QSharedPointer<QList<QtOpenGLViewer*> > _cameraLinks;
+    QElapsedTimer _startupTimer;
+    qint64 _startupNsecs = -1;
+    QtOpenGLInputRecorder *_inputRecorder = NULL;
+    QtOpenGLLatencyHistogram *_latencyHistogram = NULL;
+    QElapsedTimer _latencyClock;
+    QVector<qint64> _pendingInputTimes; // when input not yet reflected in a frame arrived
+    quint64 _frameRequests = 0;
+};
+
+/* --------------------------------------------------------------------------------
+ * Persistent shader program binary cache.
+ *
+ * Linked program binaries (glGetProgramBinary) are stored on disk keyed by a hash of
+ * the shader sources and the driver's vendor, renderer and version strings, so later
+ * launches skip compiling and linking. If the driver rejects a cached binary (e.g.
+ * after a driver update) the program is compiled from source and the cache entry is
+ * replaced. Without program binary support this just compiles and links.
+ * -------------------------------------------------------------------------------- */
+class QtOpenGLProgramCache
+{
+public:
+    static QtOpenGLProgramCache &instance();
+    
+    bool isEnabled() const { return _isEnabled; }
+    void setEnabled(bool b) { _isEnabled = b; }
+    
+    QString cacheDirectory() const { return _cacheDirectory; }
+    void setCacheDirectory(const QString &path) { _cacheDirectory = path; }
+    void clear();
+    
+    // Load or compile and link program (requires a current OpenGL context).
+    // Returns false on compile or link errors, see program->log().
+    bool build(QOpenGLShaderProgram *program, const QString &vertexShader, const QString &fragmentShader);
+    
+    // cold = compiled from source, warm = loaded from cached binary
+    int coldBuilds() const { return _coldBuilds; }
+    int warmBuilds() const { return _warmBuilds; }
+    int rejectedBinaries() const { return _rejectedBinaries; }
+    qint64 coldNsecs() const { return _coldNsecs; }
+    qint64 warmNsecs() const { return _warmNsecs; }
+    
+private:
+    QtOpenGLProgramCache();
+    QtOpenGLProgramCache(const QtOpenGLProgramCache&);
+    QtOpenGLProgramCache &operator=(const QtOpenGLProgramCache&);
+    
+    bool isSupported(QOpenGLContext *context);
+    QString cachePath(QOpenGLContext *context, const QString &vertexShader, const QString &fragmentShader);
+    
+    bool _isEnabled = true;
+    QString _cacheDirectory;
+    int _coldBuilds = 0;
+    int _warmBuilds = 0;
+    int _rejectedBinaries = 0;
+    qint64 _coldNsecs = 0;
+    qint64 _warmNsecs = 0;
+};
+
+/* --------------------------------------------------------------------------------
+ * GL resource pool shared by all viewers.
+ *
+ * Buffers, textures and shader programs are reference counted and keyed by content
+ * so that viewers showing the same data upload it only once. Resources belong to the
+ * share group of the context that is current when they are acquired, so set
+ * Qt::AA_ShareOpenGLContexts before constructing QApplication to have all viewers
+ * share a single group. Unreferenced resources stay cached until the memory budget
+ * forces least recently used eviction. Programs are built via QtOpenGLProgramCache.
+ *
+ * All functions except the budget accessors require a current OpenGL context.
+ *
+ * Acquired pointers stay valid until released, unless the last context in their
+ * share group is destroyed (e.g. a viewer closes without Qt::AA_ShareOpenGLContexts).
+ * Then the group's resources are deleted, referenced or not, and resourcesLost() is
+ * emitted with their keys; holders must drop their pointers and acquire again.
+ * -------------------------------------------------------------------------------- */
+class QtOpenGLResourcePool : public QObject
+{
+    Q_OBJECT
+    
+public:
+    static QtOpenGLResourcePool &instance();
+    static QByteArray contentKey(const void *data, int bytes);
+    
+    qint64 memoryBudget() const { return _memoryBudget; }
+    void setMemoryBudget(qint64 bytes);
+    qint64 memoryUsage() const { return _memoryUsage; }
+    
+    // each acquire must be matched by a release of the same key
+    QOpenGLBuffer *acquireBuffer(const QByteArray &key, const void *data, int bytes, QOpenGLBuffer::Type type = QOpenGLBuffer::VertexBuffer);
+    QOpenGLTexture *acquireTexture(const QByteArray &key, const QImage &image);
+    QOpenGLShaderProgram *acquireProgram(const QByteArray &key, const QString &vertexShader, const QString &fragmentShader);
+    void release(const QByteArray &key);
+    
+signals:
+    // emitted after the group's resources that were still acquired have been deleted
+    void resourcesLost(QOpenGLContextGroup *group, const QList<QByteArray> &keys);
+    
+private:
+    QtOpenGLResourcePool() {}
+    QtOpenGLResourcePool(const QtOpenGLResourcePool&);
+    QtOpenGLResourcePool &operator=(const QtOpenGLResourcePool&);
+    
+    struct Resource {
+        QOpenGLBuffer *buffer = NULL;
+        QOpenGLTexture *texture = NULL;
+        QOpenGLShaderProgram *program = NULL;
+        qint64 bytes = 0;
+        int refCount = 0;
+        quint64 lastUsed = 0;
+    };
+    typedef QPair<QOpenGLContextGroup*, QByteArray> ResourceKey;
+    
+    QOpenGLContextGroup *currentGroup();
+    Resource *find(const QByteArray &key);
+    void retain(Resource *resource);
+    void watch(QOpenGLContext *context);
+    Resource *insert(const QByteArray &key, const Resource &resource);
+    void destroy(const ResourceKey &key);
+    void evict();
+    void contextAboutToBeDestroyed(QOpenGLContext *context);
+    
+    QHash<ResourceKey, Resource> _resources;
+    QSet<QOpenGLContext*> _contexts;
+    qint64 _memoryBudget = 512 * 1024 * 1024;
+    qint64 _memoryUsage = 0;
+    quint64 _clock = 0;
+};
+
+/* --------------------------------------------------------------------------------
+ * Memory-mapped multi-resolution tile pyramid for very large 2D images.
+ *
+ * Level 0 is the full resolution image, each following level is downsampled by two
+ * until the whole image fits in a single tile. Tiles are stored uncompressed as
+ * tileSize x tileSize RGBA8 (rows top to bottom, edge tiles padded with transparent
+ * pixels) at fixed offsets, so any tile can be read straight from the mapped file.
+ * -------------------------------------------------------------------------------- */
+class QtOpenGLTilePyramid
+{
+public:
+    QtOpenGLTilePyramid() {}
+    ~QtOpenGLTilePyramid() { close(); }
+    
+    bool open(const QString &path);
+    void close();
+    bool isOpen() const { return _data != NULL; }
+    
+    qint64 width() const { return _levels.isEmpty() ? 0 : _levels[0].width; }
+    qint64 height() const { return _levels.isEmpty() ? 0 : _levels[0].height; }
+    int tileSize() const { return _tileSize; }
+    int levels() const { return _levels.size(); }
+    int tilesX(int level) const { return _levels[level].tilesX; }
+    int tilesY(int level) const { return _levels[level].tilesY; }
+    
+    // RGBA8 pixels of a tile (NULL if out of range)
+    const uchar *tile(int level, int tx, int ty) const;
+    
+    // Converters. Raw input is 8-bit gray (1 channel), RGB (3) or RGBA (4) pixels in row major order
+    // and is memory-mapped, so it can be any size. Image input is decoded whole with QImageReader and
+    // must fit in a QImage, convert gigapixel images (e.g. large TIFFs) to raw first.
+    static bool buildFromRaw(const QString &rawPath, qint64 width, qint64 height, int channels, const QString &pyramidPath, int tileSize = 256);
+    static bool buildFromImage(const QString &imagePath, const QString &pyramidPath, int tileSize = 256);
+    
+private:
+    QtOpenGLTilePyramid(const QtOpenGLTilePyramid&);
+    QtOpenGLTilePyramid &operator=(const QtOpenGLTilePyramid&);
+    
+    struct Level {
+        qint64 width = 0;
+        qint64 height = 0;
+        qint32 tilesX = 0;
+        qint32 tilesY = 0;
+        qint64 offset = 0;
+    };
+    static const quint32 Magic = 0x51545059; // "QTPY"
+    static const quint32 Version = 1;
+    static const qint64 HeaderSize = 4096;
+    static const int MaxTileSize = 8192;
+    static const int MaxLevels = 64;
+    static const qint64 MaxImageSize = qint64(1) << 40; // pixels per side
+    static const qint64 MaxTiles = qint64(1) << 24; // per side, QtOpenGLImageLayer tile keys hold 24 bits per coordinate
+    
+    // empty if the size is out of range or the file size would overflow a qint64
+    static QVector<Level> layout(qint64 width, qint64 height, int tileSize);
+    // writes a pyramid from bands of tileSize rows (RGBA8888) returned by readBand(y, rows)
+    static bool build(const QString &pyramidPath, qint64 width, qint64 height, int tileSize, const std::function<QImage(qint64 y, int rows)> &readBand);
+    
+    QFile _file;
+    uchar *_data = NULL;
+    int _tileSize = 0;
+    QVector<Level> _levels;
+};
+
+/* --------------------------------------------------------------------------------
+ * 2D image layer streamed from a QtOpenGLTilePyramid.
+ *
+ * Call draw() from drawScene() of a 2D viewer. Tiles in view at the level matching
+ * the current zoom are requested nearest to the view center first, read on background
+ * threads and uploaded into a fixed size GPU texture atlas with least recently used
+ * replacement. Coarser levels are drawn underneath while finer tiles load.
+ *
+ * The atlas belongs to the share group of the viewer the layer is drawn in and is
+ * rebuilt if that group goes away or the layer is drawn in a viewer of another group
+ * (leaving the old atlas to its group). Delete the layer with a context of the group
+ * current to free the atlas.
+ * -------------------------------------------------------------------------------- */
+class QtOpenGLImageLayer : public QObject, protected QOpenGLFunctions
+{
+    Q_OBJECT
+    
+public:
+    QtOpenGLImageLayer(QObject *parent = NULL) : QObject(parent) {}
+    virtual ~QtOpenGLImageLayer();
+    
+    bool open(const QString &pyramidPath);
+    void close();
+    QSharedPointer<QtOpenGLTilePyramid> pyramid() const { return _pyramid; }
+    
+    // world placement (image top row is at the top, bottom-left corner at position)
+    QPointF position() const { return _position; }
+    void setPosition(const QPointF &position) { _position = position; }
+    float pixelSize() const { return _pixelSize; }
+    void setPixelSize(float f) { _pixelSize = f > 0 ? f : 1; }
+    QRectF worldRect() const;
+    
+    // atlas size in tiles per side (takes effect on the next draw), the view is drawn
+    // from coarser levels if its tiles don't fit
+    int atlasTiles() const { return _atlasTiles; }
+    void setAtlasTiles(int n) { _atlasTiles = n > 1 ? n : 2; }
+    
+    // max tiles being read at once
+    int maxPendingTiles() const { return _maxPendingTiles; }
+    void setMaxPendingTiles(int n) { _maxPendingTiles = n > 0 ? n : 1; }
+    
+    void draw(QtOpenGLViewer *viewer);
+    
+signals:
+    void tileLoaded();
+    
+private slots:
+    void tileRead(int generation, quint64 key, const QImage &image);
+    void contextAboutToBeDestroyed();
+    
+private:
+    static quint64 tileKey(int level, int tx, int ty) { return (quint64(level) << 48) | (quint64(ty) << 24) | quint64(tx); }
+    void setContext(QOpenGLContext *context);
+    void resetAtlas();
+    void createAtlas();
+    void uploadTiles();
+    void drawTile(int level, int tx, int ty, int slot);
+    
+    QSharedPointer<QtOpenGLTilePyramid> _pyramid;
+    QPointF _position = QPointF(0, 0);
+    float _pixelSize = 1;
+    int _atlasTiles = 16;
+    int _maxPendingTiles = 2 * QThread::idealThreadCount();
+    QThreadPool _threadPool;
+    int _generation = 0;
+    QSet<quint64> _pendingTiles;
+    QHash<quint64, QImage> _readTiles;
+    
+    // atlas
+    QOpenGLContext *_context = NULL;
+    GLuint _atlas = 0;
+    int _atlasSize = 0; // tiles per side
+    int _atlasTileSize = 0;
+    int _createdAtlasTiles = 0; // _atlasTiles the atlas was created for
+    quint64 _frame = 0;
+    QHash<quint64, int> _slotOfTile;
+    QVector<quint64> _tileInSlot;
+    QVector<quint64> _slotLastUsed;
+};
+
+/* --------------------------------------------------------------------------------
+ * 2D time-series layer for very long signals.
+ *
+ * Samples are uniformly spaced, sample i is drawn at x = startX + i * sampleInterval.
+ * A multi-resolution min/max summary (level k buckets hold 8 << k samples) is updated
+ * incrementally on append, and draw() picks the level with about one bucket per pixel
+ * column, so spikes are never lost and each frame streams O(pixels) vertices into a GPU
+ * line buffer regardless of how many samples there are. With a capacity set, the oldest
+ * samples are dropped so memory stays bounded (about 6 bytes per sample).
+ * -------------------------------------------------------------------------------- */
+class QtOpenGLTimeSeriesLayer : public QObject, protected QOpenGLFunctions
+{
+    Q_OBJECT
+    
+public:
+    QtOpenGLTimeSeriesLayer(QObject *parent = NULL) : QObject(parent) {}
+    virtual ~QtOpenGLTimeSeriesLayer() {}
+    
+    double startX() const { return _startX; }
+    void setStartX(double x) { _startX = x; _revision++; }
+    double sampleInterval() const { return _sampleInterval; }
+    void setSampleInterval(double dx) { _sampleInterval = dx > 0 ? dx : 1; _revision++; }
+    
+    QColor color() const { return _color; }
+    void setColor(const QColor &color) { _color = color; }
+    float lineWidth() const { return _lineWidth; }
+    void setLineWidth(float f) { _lineWidth = f > 0 ? f : 1; }
+    
+    // max samples kept (0 = unbounded), older samples are dropped on append
+    qint64 capacity() const { return _capacity; }
+    void setCapacity(qint64 n);
+    
+    // retained samples are firstIndex() ... firstIndex() + size() - 1
+    qint64 firstIndex() const { return _first; }
+    qint64 size() const { return qint64(_samples.size()); }
+    void clear();
+    void append(const float *samples, qint64 count);
+    void append(float sample) { append(&sample, 1); }
+    float sample(qint64 index) const { return _samples[size_t(index - _first)]; }
+    
+    // min/max summary, bucket b of a level covers the retained samples in b * bucketSize(level) ... (b + 1) * bucketSize(level) - 1
+    int levels() const { return _levels.size(); }
+    static qint64 bucketSize(int level) { return qint64(BaseBucketSize) << level; }
+    qint64 firstBucket(int level) const { return _levels[level].first; }
+    qint64 bucketCount(int level) const { return qint64(_levels[level].min.size()); }
+    float bucketMin(int level, qint64 bucket) const { return _levels[level].min[size_t(bucket - _levels[level].first)]; }
+    float bucketMax(int level, qint64 bucket) const { return _levels[level].max[size_t(bucket - _levels[level].first)]; }
+    
+    void draw(QtOpenGLViewer *viewer);
+    
+private:
+    static const int BaseBucketSize = 8;
+    struct Level {
+        qint64 first = 0; // index of first bucket
+        std::deque<float> min;
+        std::deque<float> max;
+    };
+    
+    void updateBucket(int level, qint64 bucket);
+    void updateLevels(qint64 fromIndex);
+    void dropOldest(qint64 count);
+    
+    double _startX = 0;
+    double _sampleInterval = 1;
+    QColor _color = QColor(0, 0, 0);
+    float _lineWidth = 1;
+    qint64 _capacity = 0;
+    qint64 _first = 0;
+    std::deque<float> _samples;
+    QVector<Level> _levels;
+    quint64 _revision = 0;
+    
+    // line buffer and the view it was built for
+    QOpenGLBuffer _lineBuffer;
+    QVector<float> _vertices;
+    qint64 _drawnStart = -1;
+    qint64 _drawnEnd = -1;
+    int _drawnLevel = 0;
+    quint64 _drawnRevision = 0;
+};
+
+/* --------------------------------------------------------------------------------
+ * Input event recorder.
+ *
+ * Writes the mouse, wheel and key events a viewer receives to a compact binary log
+ * (time since the previous event, event type and only the fields the viewer uses).
+ * Attach with viewer->setInputRecorder(&recorder) and replay the log with
+ * QtOpenGLInputReplayer.
+ * -------------------------------------------------------------------------------- */
+class QtOpenGLInputRecorder
+{
+public:
+    QtOpenGLInputRecorder() {}
+    ~QtOpenGLInputRecorder() { stop(); }
+    
+    bool start(const QString &path);
+    void stop();
+    bool isRecording() const { return _file.isOpen(); }
+    int count() const { return _count; }
+    
+    static bool isRecordable(QEvent::Type type);
+    void record(const QEvent *event);
+    
+private:
+    friend class QtOpenGLInputReplayer;
+    static const quint32 Magic = 0x51544952; // "QTIR"
+    static const quint32 Version = 1;
+    
+    QtOpenGLInputRecorder(const QtOpenGLInputRecorder&);
+    QtOpenGLInputRecorder &operator=(const QtOpenGLInputRecorder&);
+    
+    QFile _file;
+    QDataStream _stream;
+    QElapsedTimer _clock;
+    qint64 _lastNsecs = 0;
+    int _count = 0;
+};
+
+/* --------------------------------------------------------------------------------
+ * Replays a QtOpenGLInputRecorder log into a viewer (or any widget).
+ *
+ * Events are sent exactly as the viewer's event handlers saw them, either with their
+ * original timing or back to back. A viewer that is not visible (offscreen) is
+ * rendered with grabFramebuffer() after each event that requests a frame, which requires
+ * Qt::AA_ShareOpenGLContexts (or run shown on the offscreen platform plugin).
+ * -------------------------------------------------------------------------------- */
+class QtOpenGLInputReplayer
+{
+public:
+    enum Speed { OriginalSpeed, MaximumSpeed };
+    
+    // returns the number of events replayed or -1 if the log can't be read
+    static int replay(const QString &path, QWidget *widget, Speed speed = OriginalSpeed);
+};
+
+/* --------------------------------------------------------------------------------
+ * Input-to-frame latency histogram.
+ *
+ * Log spaced bins from 10 us to 10 s. Set on a viewer with setLatencyHistogram() to
+ * add the time from each input event whose handler calls requestFrame() until the end
+ * of that frame (after glFinish). Save histograms from different builds and compare()
+ * them.
+ * -------------------------------------------------------------------------------- */
+class QtOpenGLLatencyHistogram
+{
+public:
+    QtOpenGLLatencyHistogram() { clear(); }
+    
+    void clear();
+    void add(qint64 nsecs);
+    qint64 count() const { return _count; }
+    double meanMsecs() const { return _count ? _sumNsecs / _count / 1e6 : 0; }
+    double maxMsecs() const { return _maxNsecs / 1e6; }
+    double percentileMsecs(double percent) const; // upper edge of the bin containing the percentile (at most the max)
+    
+    QString toString() const;
+    bool save(const QString &path) const;
+    bool load(const QString &path);
+    static QString compare(const QtOpenGLLatencyHistogram &baseline, const QtOpenGLLatencyHistogram &current);
+    
+private:
+    static const int BinsPerDecade = 20;
+    static const int Decades = 6;
+    static double binUpperNsecs(int bin);
+    
+    QVector<qint64> _bins; // [0] < 10 us, [last] >= 10 s
+    qint64 _count = 0;
+    double _sumNsecs = 0;
+    qint64 _maxNsecs = 0;
+};
+
+/* --------------------------------------------------------------------------------
+ * GPU colormapped per-vertex scalar field.
+ *
+ * Positions and raw float scalars are uploaded once on the next draw() after they
+ * are set, and colors are looked up per fragment from a 256 entry colormap texture.
+ * Colormap, range, clamping and log scaling are shader uniforms, so changing them
+ * never touches the vertex data. Draw from drawScene().
+ *
+ * The GPU data belongs to the share group of the viewer the field is drawn in. A CPU
+ * copy is kept, so everything is uploaded again if that group goes away or the field
+ * is drawn in a viewer of another group. Delete the field with a context of the group
+ * current, otherwise its program and colormap stay referenced in the resource pool.
+ * -------------------------------------------------------------------------------- */
+class QtOpenGLScalarField : public QObject, protected QOpenGLFunctions
+{
+    Q_OBJECT
+    
+public:
+    enum Colormap { Gray, Viridis, Jet, Hot, CoolWarm };
+    
+    QtOpenGLScalarField(QObject *parent = NULL) : QObject(parent), _indexBuffer(QOpenGLBuffer::IndexBuffer) {}
+    virtual ~QtOpenGLScalarField();
+    
+    // xyz per vertex, one scalar per vertex, optional element indices
+    void setPositions(const float *xyz, int vertexCount);
+    void setScalars(const float *values, int vertexCount);
+    void setIndices(const GLuint *indices, int count);
+    int vertexCount() const { return _vertexCount; }
+    
+    Colormap colormap() const { return _colormap; }
+    void setColormap(Colormap map) { _colormap = map; }
+    static QImage colormapImage(Colormap map); // 256 x 1 RGBA
+    
+    float rangeMin() const { return _rangeMin; }
+    float rangeMax() const { return _rangeMax; }
+    void setRange(float min, float max) { _rangeMin = min; _rangeMax = max; }
+    
+    // values outside the range get the end colors if clamped, otherwise they are not drawn
+    bool clampRange() const { return _clampRange; }
+    void setClampRange(bool b) { _clampRange = b; }
+    
+    bool logScale() const { return _logScale; }
+    void setLogScale(bool b) { _logScale = b; }
+    
+    // mode is e.g. GL_POINTS, GL_LINES or GL_TRIANGLES
+    void draw(GLenum mode = GL_TRIANGLES);
+    
+private slots:
+    void contextAboutToBeDestroyed();
+    
+private:
+    static QByteArray colormapKey(Colormap map);
+    void setContext(QOpenGLContext *context);
+    void resetGL();
+    
+    int _vertexCount = 0;
+    int _scalarCount = 0;
+    int _indexCount = 0;
+    QVector<float> _positions;
+    QVector<float> _scalars;
+    QVector<GLuint> _indices;
+    Colormap _colormap = Viridis;
+    float _rangeMin = 0;
+    float _rangeMax = 1;
+    bool _clampRange = true;
+    bool _logScale = false;
+    
+    // GL
+    QOpenGLContext *_context = NULL;
+    QOpenGLBuffer _positionBuffer;
+    QOpenGLBuffer _scalarBuffer;
+    QOpenGLBuffer _indexBuffer;
+    QOpenGLShaderProgram *_program = NULL;
+    QOpenGLTexture *_colormapTexture = NULL;
+    Colormap _textureColormap = Viridis;
+    bool _positionsUploaded = false;
+    bool _scalarsUploaded = false;
+    bool _indicesUploaded = false;
 };
 
 #endif
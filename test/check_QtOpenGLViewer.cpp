@@ -0,0 +1,477 @@
+/* --------------------------------------------------------------------------------
+ * Checks for the parts of QtOpenGLViewer that don't need an OpenGL context.
+ *
+ * Returns the number of failed checks.
+ * -------------------------------------------------------------------------------- */
+
+#include "QtOpenGLViewer.h"
+
+#include <QApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QWheelEvent>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+static int failures = 0;
+
+static void check(bool ok, const QString &what)
+{
+    if(!ok) {
+        qWarning() << "FAILED:" << what;
+        failures++;
+    }
+}
+
+// deterministic pseudo random numbers so failures can be reproduced
+static quint32 random(quint32 &state)
+{
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+// compares every tile of every level with levels recomputed from the level 0 RGBA pixels
+static void checkPyramidLevels(const QtOpenGLTilePyramid &pyramid, std::vector<uchar> pixels, qint64 width, qint64 height, const QString &name)
+{
+    int tileSize = pyramid.tileSize();
+    if(pyramid.width() != width || pyramid.height() != height || pyramid.levels() < 1) {
+        check(false, name + QString(": opened as %1x%2 with %3 levels").arg(pyramid.width()).arg(pyramid.height()).arg(pyramid.levels()));
+        return;
+    }
+    for(int level = 0; level < pyramid.levels(); ++level) {
+        if(level > 0) {
+            // average of the 2x2 pixels (fewer at odd edges), rounded
+            qint64 coarseWidth = (width + 1) / 2, coarseHeight = (height + 1) / 2;
+            std::vector<uchar> coarse(size_t(coarseWidth * coarseHeight * 4));
+            for(qint64 y = 0; y < coarseHeight; ++y) {
+                for(qint64 x = 0; x < coarseWidth; ++x) {
+                    for(int c = 0; c < 4; ++c) {
+                        int sum = 0, count = 0;
+                        for(qint64 sy = 2 * y; sy < qMin(2 * y + 2, height); ++sy) {
+                            for(qint64 sx = 2 * x; sx < qMin(2 * x + 2, width); ++sx) {
+                                sum += pixels[size_t((sy * width + sx) * 4 + c)];
+                                ++count;
+                            }
+                        }
+                        coarse[size_t((y * coarseWidth + x) * 4 + c)] = uchar((sum + count / 2) / count);
+                    }
+                }
+            }
+            pixels.swap(coarse);
+            width = coarseWidth;
+            height = coarseHeight;
+        }
+        int tilesX = int((width + tileSize - 1) / tileSize);
+        int tilesY = int((height + tileSize - 1) / tileSize);
+        if(pyramid.tilesX(level) != tilesX || pyramid.tilesY(level) != tilesY) {
+            check(false, name + QString(": level %1 has %2x%3 tiles, expected %4x%5").arg(level).arg(pyramid.tilesX(level)).arg(pyramid.tilesY(level)).arg(tilesX).arg(tilesY));
+            return;
+        }
+        // padding outside the image is transparent black
+        for(int ty = 0; ty < tilesY; ++ty) {
+            for(int tx = 0; tx < tilesX; ++tx) {
+                const uchar *tile = pyramid.tile(level, tx, ty);
+                if(!tile) {
+                    check(false, name + QString(": level %1 tile %2,%3 is missing").arg(level).arg(tx).arg(ty));
+                    return;
+                }
+                for(int i = 0; i < tileSize * tileSize * 4; ++i) {
+                    qint64 x = qint64(tx) * tileSize + (i / 4) % tileSize;
+                    qint64 y = qint64(ty) * tileSize + (i / 4) / tileSize;
+                    uchar expected = x < width && y < height ? pixels[size_t((y * width + x) * 4 + i % 4)] : 0;
+                    if(tile[i] != expected) {
+                        check(false, name + QString(": level %1 pixel %2,%3 channel %4 is %5, expected %6").arg(level).arg(x).arg(y).arg(i % 4).arg(tile[i]).arg(expected));
+                        return;
+                    }
+                }
+            }
+        }
+    }
+    int last = pyramid.levels() - 1;
+    check(pyramid.tilesX(last) == 1 && pyramid.tilesY(last) == 1 && (last == 0 || pyramid.tilesX(last - 1) > 1 || pyramid.tilesY(last - 1) > 1), name + ": levels stop at a single tile");
+    check(!pyramid.tile(0, -1, 0) && !pyramid.tile(0, pyramid.tilesX(0), 0) && !pyramid.tile(0, 0, pyramid.tilesY(0)) && !pyramid.tile(pyramid.levels(), 0, 0), name + ": tiles out of range");
+}
+
+static bool writeFile(const QString &path, const QByteArray &bytes)
+{
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly | QIODevice::Truncate) && file.write(bytes) == bytes.size();
+}
+
+static void checkTilePyramid()
+{
+    QTemporaryDir dir;
+    QString rawPath = dir.filePath("image.raw");
+    QString pyramidPath = dir.filePath("image.pyramid");
+    
+    // raw gray, RGB and RGBA at sizes that aren't multiples of the tile size
+    struct Size {
+        qint64 width, height;
+        int channels, tileSize;
+    };
+    const Size sizes[] = {{37, 21, 3, 16}, {9, 5, 1, 4}, {16, 16, 4, 8}, {1, 1, 4, 4}, {70, 3, 4, 8}};
+    for(const Size &size : sizes) {
+        QString name = QString("%1x%2 pyramid from %3 channels with %4 pixel tiles").arg(size.width).arg(size.height).arg(size.channels).arg(size.tileSize);
+        QByteArray raw(int(size.width * size.height * size.channels), 0);
+        quint32 state = quint32(size.width * 31 + size.height);
+        for(int i = 0; i < raw.size(); ++i) {
+            raw[i] = char(random(state));
+        }
+        std::vector<uchar> pixels(size_t(size.width * size.height * 4));
+        for(qint64 i = 0; i < size.width * size.height; ++i) {
+            for(int c = 0; c < 4; ++c) {
+                uchar value = 255; // gray and RGB are opaque
+                if(size.channels == 1 && c < 3) value = uchar(raw[int(i)]);
+                else if(c < size.channels) value = uchar(raw[int(i * size.channels + c)]);
+                pixels[size_t(i * 4 + c)] = value;
+            }
+        }
+        check(writeFile(rawPath, raw), name + ": write raw pixels");
+        QtOpenGLTilePyramid pyramid;
+        if(!QtOpenGLTilePyramid::buildFromRaw(rawPath, size.width, size.height, size.channels, pyramidPath, size.tileSize) || !pyramid.open(pyramidPath)) {
+            check(false, name + ": build and open");
+            continue;
+        }
+        checkPyramidLevels(pyramid, pixels, size.width, size.height, name);
+    }
+    
+    // invalid raw input is rejected before it is mapped
+    check(!QtOpenGLTilePyramid::buildFromRaw(rawPath, 70, 3, 2, pyramidPath, 8), "raw with 2 channels");
+    check(!QtOpenGLTilePyramid::buildFromRaw(rawPath, 0, 3, 4, pyramidPath, 8), "raw with no columns");
+    check(!QtOpenGLTilePyramid::buildFromRaw(rawPath, 71, 3, 4, pyramidPath, 8), "raw larger than its file");
+    check(!QtOpenGLTilePyramid::buildFromRaw(rawPath, 70, 3, 4, pyramidPath, 0), "raw with no tile size");
+    check(!QtOpenGLTilePyramid::buildFromRaw(rawPath, qint64(1) << 40, qint64(1) << 40, 4, pyramidPath, 8192), "raw with 2^80 pixels");
+    check(!QtOpenGLTilePyramid::buildFromRaw(rawPath, 1 << 20, qint64(1) << 40, 4, pyramidPath, 1), "raw with too many tiles");
+    
+    // decoded images
+    QImage image(13, 7, QImage::Format_RGBA8888);
+    quint32 state = 7;
+    for(int y = 0; y < image.height(); ++y) {
+        for(int x = 0; x < image.width() * 4; ++x) {
+            image.scanLine(y)[x] = uchar(random(state));
+        }
+    }
+    QString imagePath = dir.filePath("image.png");
+    check(image.save(imagePath), "save png");
+    QtOpenGLTilePyramid fromImage;
+    if(QtOpenGLTilePyramid::buildFromImage(imagePath, pyramidPath, 4) && fromImage.open(pyramidPath)) {
+        std::vector<uchar> pixels;
+        for(int y = 0; y < image.height(); ++y) {
+            pixels.insert(pixels.end(), image.constScanLine(y), image.constScanLine(y) + image.width() * 4);
+        }
+        checkPyramidLevels(fromImage, pixels, image.width(), image.height(), "13x7 pyramid from png with 4 pixel tiles");
+    } else {
+        check(false, "build and open pyramid from png");
+    }
+    fromImage.close();
+    
+    // truncated or corrupted files are rejected
+    check(QtOpenGLTilePyramid::buildFromRaw(rawPath, 70, 3, 4, pyramidPath, 8), "build 70x3 pyramid");
+    QFile file(pyramidPath);
+    QByteArray original = file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+    file.close();
+    QString corruptPath = dir.filePath("corrupt.pyramid");
+    auto opens = [&](const QByteArray &bytes) {
+        QtOpenGLTilePyramid pyramid;
+        return writeFile(corruptPath, bytes) && pyramid.open(corruptPath);
+    };
+    check(opens(original), "copy of a pyramid");
+    check(!opens(original.left(original.size() - 1)), "pyramid missing its last byte");
+    check(!opens(original.left(100)), "pyramid with only a header");
+    check(!opens(QByteArray()), "empty pyramid");
+    // big endian header: magic, version, tile size, level count (32 bit), then per level
+    // width, height (64 bit), tiles x, tiles y (32 bit) and offset (64 bit)
+    struct Corruption {
+        int byte;
+        const char *field;
+    };
+    const Corruption corruptions[] = {
+        {3, "magic"}, {7, "version"}, {11, "tile size"}, {15, "level count"}, {23, "width"}, {31, "height"},
+        {35, "tiles x"}, {39, "tiles y"}, {47, "offset"}, {16 + 32 + 31, "offset of level 1"}, {16 + 4 * 32 + 19, "tiles x of the last level"}
+    };
+    for(const Corruption &corruption : corruptions) {
+        QByteArray bytes = original;
+        bytes[corruption.byte] = char(bytes[corruption.byte] + 1);
+        check(!opens(bytes), QString("pyramid with corrupted %1").arg(corruption.field));
+    }
+    // sizes whose tile counts or file size don't fit
+    QByteArray bytes = original;
+    bytes.replace(16, 8, QByteArray::fromHex("0000000040000000")); // 2^30 pixels wide, 2^27 tiles
+    check(!opens(bytes), "pyramid with too many tiles per side");
+    bytes = original;
+    bytes.replace(8, 4, QByteArray::fromHex("00002000")); // 8192 pixel tiles
+    bytes.replace(16, 16, QByteArray::fromHex("00000000800000000000000080000000")); // 2^31 x 2^31 pixels, 2^64 bytes
+    check(!opens(bytes), "pyramid larger than 2^63 bytes");
+}
+
+// compares the incremental min/max levels with ones recomputed from all samples appended so far
+static void checkTimeSeries(const QtOpenGLTimeSeriesLayer &series, const std::vector<float> &all, qint64 capacity, const QString &name)
+{
+    qint64 end = qint64(all.size());
+    qint64 first = capacity > 0 ? qMax(qint64(0), end - capacity) : 0;
+    if(series.firstIndex() != first || series.firstIndex() + series.size() != end) {
+        check(false, name + QString(": retained samples %1 ... %2, expected %3 ... %4").arg(series.firstIndex()).arg(series.firstIndex() + series.size()).arg(first).arg(end));
+        return;
+    }
+    for(qint64 i = first; i < end; ++i) {
+        if(series.sample(i) != all[size_t(i)]) {
+            check(false, name + QString(": sample %1").arg(i));
+            return;
+        }
+    }
+    // a level exists at least once there are two of its buckets
+    int levels = 0;
+    while(end - first >= 2 * QtOpenGLTimeSeriesLayer::bucketSize(levels)) levels++;
+    check(series.levels() >= levels, name + QString(": %1 levels, expected at least %2").arg(series.levels()).arg(levels));
+    for(int level = 0; level < series.levels(); ++level) {
+        qint64 n = QtOpenGLTimeSeriesLayer::bucketSize(level);
+        if(series.firstBucket(level) != first / n || series.bucketCount(level) != (end - 1) / n - first / n + 1) {
+            check(false, name + QString(": level %1 has buckets %2 + %3, expected %4 + %5").arg(level)
+                  .arg(series.firstBucket(level)).arg(series.bucketCount(level)).arg(first / n).arg((end - 1) / n - first / n + 1));
+            return;
+        }
+        for(qint64 bucket = first / n; bucket <= (end - 1) / n; ++bucket) {
+            float lo = all[size_t(qMax(bucket * n, first))], hi = lo;
+            for(qint64 i = qMax(bucket * n, first); i < qMin((bucket + 1) * n, end); ++i) {
+                lo = qMin(lo, all[size_t(i)]);
+                hi = qMax(hi, all[size_t(i)]);
+            }
+            if(series.bucketMin(level, bucket) != lo || series.bucketMax(level, bucket) != hi) {
+                check(false, name + QString(": level %1 bucket %2 is %3 ... %4, expected %5 ... %6").arg(level).arg(bucket)
+                      .arg(series.bucketMin(level, bucket)).arg(series.bucketMax(level, bucket)).arg(lo).arg(hi));
+                return;
+            }
+        }
+    }
+}
+
+static void checkTimeSeriesLayer()
+{
+    // capacities around the bucket sizes so the first buckets are often partial
+    const qint64 capacities[] = {0, 1, 7, 8, 9, 31, 100, 1000};
+    for(qint64 capacity : capacities) {
+        QString name = QString("time series with capacity %1").arg(capacity);
+        QtOpenGLTimeSeriesLayer series;
+        series.setCapacity(capacity);
+        std::vector<float> all;
+        quint32 state = quint32(capacity) + 1;
+        int failed = failures;
+        for(int chunk = 0; chunk < 300 && failures == failed; ++chunk) {
+            std::vector<float> samples(1 + random(state) % 40);
+            for(float &sample : samples) {
+                sample = float(random(state) % 2001) - 1000;
+            }
+            if(chunk % 2) {
+                series.append(samples.data(), qint64(samples.size()));
+            } else {
+                for(float sample : samples) {
+                    series.append(sample);
+                }
+            }
+            all.insert(all.end(), samples.begin(), samples.end());
+            checkTimeSeries(series, all, capacity, name);
+        }
+        
+        // shrinking the capacity drops the oldest samples
+        if(capacity == 0 || capacity > 5) {
+            capacity = capacity ? capacity - 5 : 123;
+            series.setCapacity(capacity);
+            checkTimeSeries(series, all, capacity, name + " after shrinking");
+        }
+        
+        series.clear();
+        all.clear();
+        check(series.size() == 0 && series.levels() == 0, name + ": clear");
+        const float samples[] = {3, 1, 4, 1, 5, 9, 2, 6, 5, 3, 5, 8, 9, 7, 9, 3, 2, 3};
+        series.append(samples, 18);
+        all.assign(samples, samples + 18);
+        checkTimeSeries(series, all, capacity, name + " after clear");
+    }
+}
+
+// sorted samples, pth percentile is the sample with rank ceil(p / 100 * n)
+static double percentileNsecs(const std::vector<qint64> &sorted, double percent)
+{
+    qint64 rank = qMax(qint64(1), qint64(ceil(percent / 100 * sorted.size())));
+    return double(sorted[size_t(rank - 1)]);
+}
+
+static void checkLatencyHistogram()
+{
+    QtOpenGLLatencyHistogram histogram;
+    check(histogram.count() == 0 && histogram.percentileMsecs(50) == 0 && histogram.maxMsecs() == 0, "empty histogram");
+    
+    // bin edges: < 10 us, then 20 bins per decade, >= 10 s
+    const double binWidth = pow(10, 1.0 / 20);
+    struct Edge {
+        qint64 nsecs;
+        double upperNsecs;
+    };
+    const Edge edges[] = {
+        {0, 1e4}, {9999, 1e4}, {10000, 1e4 * binWidth}, {11220, 1e4 * binWidth}, {11221, 1e4 * binWidth * binWidth},
+        {99999, 1e5}, {100000, 1e5 * binWidth}, {9999999999LL, 1e10}
+    };
+    for(const Edge &edge : edges) {
+        histogram.clear();
+        histogram.add(edge.nsecs);
+        histogram.add(100000000000LL); // keeps the max out of the way
+        double msecs = histogram.percentileMsecs(50);
+        check(fabs(msecs - edge.upperNsecs / 1e6) < 1e-9 * msecs, QString("%1 ns is in the bin up to %2 ms, not %3 ms").arg(edge.nsecs).arg(edge.upperNsecs / 1e6).arg(msecs));
+    }
+    // the last bin has no upper edge
+    histogram.clear();
+    histogram.add(10000000000LL);
+    histogram.add(25000000000LL);
+    check(histogram.percentileMsecs(50) == 25000 && histogram.percentileMsecs(100) == 25000, "percentile in the last bin is the max");
+    
+    // percentiles are the upper edge of the bin holding the exact percentile, never past the max
+    histogram.clear();
+    std::vector<qint64> samples;
+    quint32 state = 1;
+    double sum = 0;
+    for(int i = 0; i < 10000; ++i) {
+        // log uniform from 1 us to 20 s
+        qint64 nsecs = qint64(1000 * pow(10, (random(state) % 1000000) / 1e6 * log10(2e7)));
+        histogram.add(nsecs);
+        samples.push_back(nsecs);
+        sum += nsecs;
+    }
+    std::sort(samples.begin(), samples.end());
+    check(histogram.count() == 10000, "histogram count");
+    check(fabs(histogram.meanMsecs() - sum / 10000 / 1e6) < 1e-9 * histogram.meanMsecs(), "histogram mean");
+    check(histogram.maxMsecs() == samples.back() / 1e6, "histogram max");
+    const double percents[] = {0, 1, 10, 50, 90, 99, 99.9, 100};
+    for(double percent : percents) {
+        double exact = percentileNsecs(samples, percent);
+        double nsecs = histogram.percentileMsecs(percent) * 1e6;
+        bool ok = nsecs >= exact * (1 - 1e-9) && nsecs <= double(samples.back()) * (1 + 1e-9);
+        if(exact < 1e4) ok = ok && nsecs <= 1e4 * (1 + 1e-9);
+        else if(exact < 1e10) ok = ok && nsecs <= exact * binWidth * (1 + 1e-9);
+        check(ok, QString("p%1 is %2 ns, exact %3 ns").arg(percent).arg(nsecs).arg(exact));
+    }
+    
+    // save/load round trip
+    QTemporaryDir dir;
+    QString path = dir.filePath("latency.csv");
+    check(histogram.save(path), "save histogram");
+    QtOpenGLLatencyHistogram loaded;
+    check(loaded.load(path), "load histogram");
+    check(loaded.count() == histogram.count() && loaded.meanMsecs() == histogram.meanMsecs() && loaded.maxMsecs() == histogram.maxMsecs(), "loaded histogram totals");
+    for(double percent : percents) {
+        check(loaded.percentileMsecs(percent) == histogram.percentileMsecs(percent), QString("loaded histogram p%1").arg(percent));
+    }
+    check(loaded.toString() == histogram.toString(), "loaded histogram summary");
+    check(QtOpenGLLatencyHistogram::compare(histogram, loaded).count("(+0.0%)") == 5, "compare equal histograms");
+    check(!loaded.load(dir.filePath("missing.csv")), "load missing histogram");
+}
+
+// the fields of an input event the viewer uses
+static QString describe(const QEvent *event)
+{
+    QString text = QString("type %1 modifiers %2").arg(int(event->type())).arg(int(static_cast<const QInputEvent*>(event)->modifiers()), 0, 16);
+    if(event->type() == QEvent::Wheel) {
+        const QWheelEvent *wheel = static_cast<const QWheelEvent*>(event);
+#if QT_VERSION >= 0x050E00
+        QPointF pos = wheel->position();
+#else
+        QPointF pos = wheel->posF();
+#endif
+        text += QString(" pos %1,%2 buttons %3 angle %4,%5 pixels %6,%7").arg(pos.x()).arg(pos.y()).arg(int(wheel->buttons()))
+        .arg(wheel->angleDelta().x()).arg(wheel->angleDelta().y()).arg(wheel->pixelDelta().x()).arg(wheel->pixelDelta().y());
+    } else if(event->type() == QEvent::KeyPress || event->type() == QEvent::KeyRelease) {
+        const QKeyEvent *key = static_cast<const QKeyEvent*>(event);
+        text += QString(" key %1 text '%2' repeat %3 count %4").arg(key->key()).arg(key->text()).arg(key->isAutoRepeat()).arg(key->count());
+    } else {
+        const QMouseEvent *mouse = static_cast<const QMouseEvent*>(event);
+        text += QString(" pos %1,%2 button %3 buttons %4").arg(mouse->localPos().x()).arg(mouse->localPos().y()).arg(int(mouse->button())).arg(int(mouse->buttons()));
+    }
+    return text;
+}
+
+// widget that logs the input events it receives
+class EventLog : public QWidget
+{
+public:
+    EventLog() { setMouseTracking(true); }
+    QStringList events;
+    
+protected:
+    bool event(QEvent *event)
+    {
+        if(!QtOpenGLInputRecorder::isRecordable(event->type())) return QWidget::event(event);
+        events.append(describe(event));
+        return true;
+    }
+};
+
+static void checkInputRecorder()
+{
+    QList<QEvent*> events;
+    events.append(new QMouseEvent(QEvent::MouseButtonPress, QPointF(10.5, 20.25), QPointF(10.5, 20.25), QPointF(110.5, 120.25), Qt::LeftButton, Qt::LeftButton, Qt::ShiftModifier));
+    events.append(new QMouseEvent(QEvent::MouseMove, QPointF(11.75, 22), QPointF(11.75, 22), QPointF(111.75, 122), Qt::NoButton, Qt::LeftButton, Qt::ShiftModifier));
+    events.append(new QMouseEvent(QEvent::MouseButtonRelease, QPointF(12, 23), QPointF(12, 23), QPointF(112, 123), Qt::LeftButton, Qt::NoButton, Qt::NoModifier));
+    events.append(new QMouseEvent(QEvent::MouseButtonDblClick, QPointF(-3, 4), QPointF(-3, 4), QPointF(97, 104), Qt::RightButton, Qt::RightButton, Qt::ControlModifier | Qt::AltModifier));
+    events.append(new QMouseEvent(QEvent::MouseMove, QPointF(5, 6), QPointF(5, 6), QPointF(105, 106), Qt::NoButton, Qt::NoButton, Qt::NoModifier));
+#if QT_VERSION >= 0x050C00
+    events.append(new QWheelEvent(QPointF(5, 6), QPointF(105, 106), QPoint(3, -7), QPoint(0, 120), Qt::MiddleButton, Qt::MetaModifier, Qt::NoScrollPhase, false));
+#else
+    events.append(new QWheelEvent(QPointF(5, 6), QPointF(105, 106), QPoint(3, -7), QPoint(0, 120), 120, Qt::Vertical, Qt::MiddleButton, Qt::MetaModifier));
+#endif
+    events.append(new QKeyEvent(QEvent::KeyPress, Qt::Key_A, Qt::NoModifier, "a"));
+    events.append(new QKeyEvent(QEvent::KeyPress, Qt::Key_Plus, Qt::KeypadModifier, "+", true, 2));
+    events.append(new QKeyEvent(QEvent::KeyRelease, Qt::Key_A, Qt::NoModifier, "a"));
+    QStringList expected;
+    for(QEvent *event : events) {
+        expected.append(describe(event));
+    }
+    
+    // record with a pause before the last event, other events are ignored
+    QTemporaryDir dir;
+    QString path = dir.filePath("input.log");
+    QtOpenGLInputRecorder recorder;
+    check(recorder.start(path), "start recording");
+    for(int i = 0; i < events.size(); ++i) {
+        if(i + 1 == events.size()) QThread::msleep(50);
+        recorder.record(events[i]);
+    }
+    QEvent resize(QEvent::Resize);
+    recorder.record(&resize);
+    recorder.stop();
+    check(recorder.count() == events.size(), QString("recorded %1 events, expected %2").arg(recorder.count()).arg(events.size()));
+    qDeleteAll(events);
+    
+    // replay back to back, then with the original timing
+    EventLog log;
+    check(QtOpenGLInputReplayer::replay(path, &log, QtOpenGLInputReplayer::MaximumSpeed) == expected.size(), "replay at maximum speed");
+    check(log.events == expected, "replayed events:\n" + log.events.join("\n") + "\nexpected:\n" + expected.join("\n"));
+    log.events.clear();
+    QElapsedTimer clock;
+    clock.start();
+    check(QtOpenGLInputReplayer::replay(path, &log, QtOpenGLInputReplayer::OriginalSpeed) == expected.size(), "replay at original speed");
+    check(clock.elapsed() >= 49, QString("replay at original speed took %1 ms").arg(clock.elapsed()));
+    check(log.events == expected, "events replayed at original speed");
+    
+    // logs from something else are rejected
+    QFile file(path);
+    check(file.open(QIODevice::WriteOnly | QIODevice::Truncate) && file.write("not an input log") > 0, "overwrite log");
+    file.close();
+    check(QtOpenGLInputReplayer::replay(path, &log) == -1, "replay a file that isn't an input log");
+    check(QtOpenGLInputReplayer::replay(dir.filePath("missing.log"), &log) == -1, "replay a missing log");
+}
+
+int main(int argc, char **argv)
+{
+    QApplication app(argc, argv);
+    
+    checkTilePyramid();
+    checkTimeSeriesLayer();
+    checkLatencyHistogram();
+    checkInputRecorder();
+    if(failures) qWarning() << failures << "checks failed";
+    return failures;
+}
@@ -0,0 +1,13 @@
+# Checks for the parts of QtOpenGLViewer that don't need an OpenGL context.
+# Build and run: qmake check_QtOpenGLViewer.pro && make && QT_QPA_PLATFORM=offscreen ./check
+
+TARGET = check
+TEMPLATE = app
+QT += core gui widgets opengl
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+SOURCES += check_QtOpenGLViewer.cpp
+
+HEADERS += ../QtOpenGLViewer.h
+SOURCES += ../QtOpenGLViewer.cpp
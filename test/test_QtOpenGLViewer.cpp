@@ -83,7 +83,7 @@ void SphereViewer::mouseMoveEvent(QMouseEvent *event)
         if(_selectedObject) {
             if(Sphere *sphere = qobject_cast<Sphere*>(_selectedObject)) {
                 sphere->center = pickPointInPlane(event->pos(), sphere->center);
-                repaint();
+                requestFrame();
                 return;
             }
         }